@@ -0,0 +1,628 @@
+// This is free and unencumbered software released into the public domain.
+//
+// Anyone is free to copy, modify, publish, use, compile, sell, or
+// distribute this software, either in source code form or as a compiled
+// binary, for any purpose, commercial or non-commercial, and by any
+// means.
+//
+// In jurisdictions that recognize copyright laws, the author or authors
+// of this software dedicate any and all copyright interest in the
+// software to the public domain. We make this dedication for the benefit
+// of the public at large and to the detriment of our heirs and
+// successors. We intend this dedication to be an overt act of
+// relinquishment in perpetuity of all present and future rights to this
+// software under copyright law.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+// EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+// MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+// IN NO EVENT SHALL THE AUTHORS BE LIABLE FOR ANY CLAIM, DAMAGES OR
+// OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE,
+// ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR
+// OTHER DEALINGS IN THE SOFTWARE.
+//
+// For more information, please refer to <https://unlicense.org>
+
+// Runs caulk against the mock Steam backend and prints one JSON object per measurement, one per line. Pass benchmark
+// names to run only those. Exits with a failure if anything went missing along the way.
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <caulk.h>
+
+#include "mock.h"
+
+#ifdef _WIN32
+#include <windows.h>
+#define sleep_ms(ms) (Sleep((ms)))
+
+static uint64_t now_ns() {
+	LARGE_INTEGER freq, count;
+	QueryPerformanceFrequency(&freq), QueryPerformanceCounter(&count);
+	return (uint64_t)((double)count.QuadPart * 1e9 / (double)freq.QuadPart);
+}
+#else
+#include <time.h>
+#include <unistd.h>
+#define sleep_ms(ms) (usleep((ms) * 1000))
+
+static uint64_t now_ns() {
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (uint64_t)ts.tv_sec * 1000000000u + (uint64_t)ts.tv_nsec;
+}
+#endif
+
+#define LENGTH(expr) (sizeof((expr)) / sizeof(*(expr)))
+
+// callback IDs that Steam doesn't use, so nothing in caulk treats them specially
+#define BENCH_CALLBACK (100000)
+
+static size_t allocations = 0;
+
+static void* counting_alloc(size_t size, void* userdata) {
+	(void)userdata;
+	allocations++;
+	return malloc(size);
+}
+
+static void counting_dealloc(void* ptr, void* userdata) {
+	(void)userdata;
+	free(ptr);
+}
+
+static bool init(bool threaded) {
+	caulk_Config config = {64, 64, counting_alloc, counting_dealloc, NULL, threaded, 0, 0, 0, 0, 0, 0};
+	caulk_MockReset();
+	return caulk_InitEx(&config);
+}
+
+static void on_callback(void* data, void* ctx) {
+	(void)data;
+	(*(size_t*)ctx)++;
+}
+
+static void on_result(void* data, bool io_failed, void* ctx) {
+	(void)data, (void)io_failed;
+	(*(size_t*)ctx)++;
+}
+
+// Fan-out cost: `num_handlers` distinct callback IDs with one subscriber each, and messages spread evenly over them.
+static bool bench_dispatch(size_t num_handlers) {
+	static const size_t num_messages = 200000;
+	static char payload[64] = {0};
+
+	if (!init(false))
+		return false;
+
+	size_t handled = 0;
+	for (size_t i = 0; i < num_handlers; i++)
+		caulk_RegisterCtx(BENCH_CALLBACK + (uint32_t)i, on_callback, &handled);
+
+	for (size_t i = 0; i < num_messages; i++)
+		caulk_MockPost(BENCH_CALLBACK + (int32_t)(i % num_handlers), payload, sizeof(payload));
+
+	allocations = 0;
+	uint64_t start = now_ns();
+	caulk_Dispatch();
+	uint64_t elapsed = now_ns() - start;
+
+	printf("{\"bench\": \"dispatch\", \"handlers\": %zu, \"messages\": %zu, \"ns_per_message\": %.2f, "
+	       "\"messages_per_sec\": %.0f, \"allocations\": %zu}\n",
+		num_handlers, num_messages, (double)elapsed / (double)num_messages,
+		(double)num_messages * 1e9 / (double)elapsed, allocations);
+
+	caulk_Shutdown();
+	return handled == num_messages && !allocations;
+}
+
+static bool bench_dispatch_small() {
+	return bench_dispatch(10);
+}
+
+static bool bench_dispatch_medium() {
+	return bench_dispatch(500);
+}
+
+static bool bench_dispatch_large() {
+	return bench_dispatch(2000);
+}
+
+static void on_persona_state_change(PersonaStateChange_t* data, void* ctx) {
+	(void)data;
+	(*(size_t*)ctx)++;
+}
+
+// The same, for a callback `steam_api.json` knows about: its handlers sit in a slot of their own, registered through
+// the typed `caulk_On*()` function.
+static bool bench_dispatch_slot() {
+	static const size_t num_messages = 200000;
+	static PersonaStateChange_t payload = {0};
+
+	if (!init(false))
+		return false;
+
+	size_t handled = 0;
+	caulk_OnPersonaStateChange(on_persona_state_change, &handled);
+	for (size_t i = 0; i < num_messages; i++)
+		caulk_MockPost(PersonaStateChange_t_iCallback, &payload, sizeof(payload));
+
+	allocations = 0;
+	uint64_t start = now_ns();
+	caulk_Dispatch();
+	uint64_t elapsed = now_ns() - start;
+
+	printf("{\"bench\": \"dispatch_slot\", \"messages\": %zu, \"ns_per_message\": %.2f, "
+	       "\"messages_per_sec\": %.0f, \"allocations\": %zu}\n",
+		num_messages, (double)elapsed / (double)num_messages, (double)num_messages * 1e9 / (double)elapsed,
+		allocations);
+
+	caulk_Shutdown();
+	return handled == num_messages && !allocations;
+}
+
+// A login-sized flood of `PersonaStateChange_t` for 1000 friends, coalesced: each friend's handler should run once per
+// dispatch, with their change flags ORed together.
+static bool bench_dispatch_coalesce() {
+	static const size_t num_messages = 200000, num_friends = 1000;
+
+	if (!init(false))
+		return false;
+
+	size_t handled = 0;
+	caulk_Coalesce(PersonaStateChange_t_iCallback, true);
+	caulk_OnPersonaStateChange(on_persona_state_change, &handled);
+
+	uint64_t elapsed = 0;
+	for (int round = 0; round < 2; round++) {
+		for (size_t i = 0; i < num_messages; i++) {
+			PersonaStateChange_t payload = {0};
+			payload.m_ulSteamID = 76561197960265729ull + i % num_friends;
+			payload.m_nChangeFlags = 1 << (i % 8);
+			caulk_MockPost(PersonaStateChange_t_iCallback, &payload, sizeof(payload));
+		}
+
+		allocations = 0, handled = 0;
+		uint64_t start = now_ns();
+		caulk_Dispatch();
+		elapsed = now_ns() - start;
+	}
+
+	printf("{\"bench\": \"dispatch_coalesce\", \"messages\": %zu, \"handler_calls\": %zu, "
+	       "\"ns_per_message\": %.2f, \"allocations\": %zu}\n",
+		num_messages, handled, (double)elapsed / (double)num_messages, allocations);
+
+	caulk_Shutdown();
+	return handled == num_friends && !allocations;
+}
+
+// Resolving calls and delivering their results. The first round grows every table, so the second one is the steady
+// state, and nothing in it should come from the allocator.
+static bool bench_resolve() {
+	static const size_t num_calls = 10000;
+	static SteamAPICall_t calls[10000];
+
+	if (!init(false))
+		return false;
+
+	size_t delivered = 0;
+	uint64_t resolve_ns = 0, deliver_ns = 0;
+	for (int round = 0; round < 2; round++) {
+		LobbyCreated_t result = {0};
+		for (size_t i = 0; i < num_calls; i++)
+			calls[i] = caulk_MockCall(LobbyCreated_t_iCallback, &result, sizeof(result), false, 0);
+
+		allocations = 0, delivered = 0;
+		uint64_t start = now_ns();
+		for (size_t i = 0; i < num_calls; i++)
+			caulk_ResolveCtx(calls[i], on_result, &delivered);
+		resolve_ns = now_ns() - start;
+
+		start = now_ns();
+		caulk_Dispatch();
+		deliver_ns = now_ns() - start;
+	}
+
+	printf("{\"bench\": \"resolve\", \"calls\": %zu, \"ns_per_resolve\": %.2f, \"ns_per_result\": %.2f, "
+	       "\"allocations\": %zu}\n",
+		num_calls, (double)resolve_ns / (double)num_calls, (double)deliver_ns / (double)num_calls, allocations);
+
+	caulk_Shutdown();
+	return delivered == num_calls && !allocations;
+}
+
+// Calls Steam never answers, given up on by `caulk_ResolveWithTimeout()` with timeouts spread over 0-255 ms. Each
+// dispatch should only pay for the timeouts that came due, however many calls are still pending.
+static bool bench_timeouts() {
+	static const size_t num_calls = 10000;
+
+	if (!init(false))
+		return false;
+
+	size_t timed_out = 0;
+	uint64_t resolve_ns = 0, dispatch_ns = 0;
+	size_t dispatches = 0;
+	for (int round = 0; round < 2; round++) {
+		allocations = 0, timed_out = 0, dispatches = 0, dispatch_ns = 0;
+		uint64_t start = now_ns();
+		for (size_t i = 0; i < num_calls; i++)
+			caulk_ResolveWithTimeout(1 + i, on_result, &timed_out, (uint32_t)(i * 7 % 256));
+		resolve_ns = now_ns() - start;
+
+		uint64_t timeout = now_ns() + 10ull * 1000000000u;
+		while (timed_out < num_calls && now_ns() < timeout) {
+			uint64_t before = now_ns();
+			caulk_Dispatch();
+			dispatch_ns += now_ns() - before, dispatches++;
+			sleep_ms(1);
+		}
+	}
+
+	printf("{\"bench\": \"timeouts\", \"calls\": %zu, \"ns_per_resolve\": %.2f, \"ns_per_timeout\": %.2f, "
+	       "\"dispatches\": %zu, \"allocations\": %zu}\n",
+		num_calls, (double)resolve_ns / (double)num_calls, (double)dispatch_ns / (double)num_calls, dispatches,
+		allocations);
+
+	caulk_Shutdown();
+	return timed_out == num_calls && !allocations;
+}
+
+// Polling call results instead of resolving them: every frame polls every call still pending, while the mock completes
+// 500 of them per frame. The first round grows the cache's index, so again the second one is what gets measured.
+static bool bench_poll() {
+	static const size_t num_calls = 10000, per_frame = 500;
+	static SteamAPICall_t calls[10000];
+
+	if (!init(false))
+		return false;
+
+	size_t ready = 0, polls = 0;
+	uint64_t poll_ns = 0;
+	for (int round = 0; round < 2; round++) {
+		LobbyCreated_t result = {0};
+		for (size_t i = 0; i < num_calls; i++)
+			calls[i] = caulk_MockCall(LobbyCreated_t_iCallback, &result, sizeof(result), false,
+				(uint32_t)(i / per_frame));
+
+		allocations = 0, ready = 0, polls = 0, poll_ns = 0;
+		size_t pending = num_calls;
+		for (size_t frame = 0; pending && frame < 2 * num_calls / per_frame; frame++) {
+			caulk_Dispatch();
+
+			size_t left = 0;
+			uint64_t start = now_ns();
+			for (size_t i = 0; i < pending; i++) {
+				bool io_failed;
+				if (caulk_Poll(calls[i], &result, sizeof(result), &io_failed) == caulk_PollReady)
+					ready++;
+				else
+					calls[left++] = calls[i];
+			}
+			poll_ns += now_ns() - start, polls += pending, pending = left;
+		}
+	}
+
+	printf("{\"bench\": \"poll\", \"calls\": %zu, \"polls\": %zu, \"ns_per_poll\": %.2f, \"allocations\": %zu}\n",
+		num_calls, polls, (double)poll_ns / (double)polls, allocations);
+
+	caulk_Shutdown();
+	return ready == num_calls && !allocations;
+}
+
+// Wrapper overhead, measured on the friend list loop from `test.c` over 2000 friends.
+static bool bench_wrappers() {
+	static const int num_friends = 2000, rounds = 100;
+	static CSteamID friends[2000];
+
+	if (!init(false))
+		return false;
+	caulk_MockSetFriends(num_friends);
+
+	uint64_t count_ns = 0, index_ns = 0, name_ns = 0;
+	size_t names = 0;
+	for (int round = 0; round < rounds; round++) {
+		uint64_t start = now_ns();
+		int count = caulk_SteamFriends_GetFriendCount(k_EFriendFlagImmediate);
+		count_ns += now_ns() - start;
+
+		start = now_ns();
+		for (int i = 0; i < count; i++)
+			friends[i] = caulk_SteamFriends_GetFriendByIndex(i, k_EFriendFlagImmediate);
+		index_ns += now_ns() - start;
+
+		start = now_ns();
+		for (int i = 0; i < count; i++) {
+			const char* name = caulk_SteamFriends_GetFriendPersonaName(friends[i]);
+			names += name && *name;
+		}
+		name_ns += now_ns() - start;
+	}
+
+	const double calls = (double)num_friends * rounds;
+	printf("{\"bench\": \"wrappers\", \"friends\": %d, \"ns_per_GetFriendCount\": %.2f, "
+	       "\"ns_per_GetFriendByIndex\": %.2f, \"ns_per_GetFriendPersonaName\": %.2f}\n",
+		num_friends, (double)count_ns / rounds, (double)index_ns / calls, (double)name_ns / calls);
+
+	caulk_MockSetFriends(0);
+	caulk_Shutdown();
+	return names == (size_t)num_friends * rounds;
+}
+
+// The same friend list read out of the snapshot instead, plus what building it and keeping it current costs.
+static bool bench_friends_snapshot() {
+	static const int num_friends = 2000, rounds = 100;
+
+	caulk_Config config = {
+		64, 64, counting_alloc, counting_dealloc, NULL, false, 0, 0, 0, 0, k_EFriendFlagImmediate, 0};
+	caulk_MockReset();
+	caulk_MockSetFriends(num_friends);
+	uint64_t start = now_ns();
+	if (!caulk_InitEx(&config))
+		return false;
+	uint64_t build_ns = now_ns() - start;
+
+	uint64_t read_ns = 0;
+	size_t names = 0;
+	for (int round = 0; round < rounds; round++) {
+		start = now_ns();
+		const caulk_FriendsSnapshot* snapshot = caulk_GetFriendsSnapshot();
+		for (size_t i = 0; i < snapshot->count; i++)
+			names += snapshot->name_text[snapshot->names[i]] != 0;
+		read_ns += now_ns() - start;
+	}
+
+	for (int i = 0; i < num_friends; i++) {
+		PersonaStateChange_t payload = {0};
+		payload.m_ulSteamID = 76561197960265729ull + (uint64_t)i;
+		payload.m_nChangeFlags = k_EPersonaChangeStatus;
+		caulk_MockPost(PersonaStateChange_t_iCallback, &payload, sizeof(payload));
+	}
+	allocations = 0;
+	start = now_ns();
+	caulk_Dispatch();
+	uint64_t update_ns = now_ns() - start;
+
+	const double calls = (double)num_friends * rounds;
+	printf("{\"bench\": \"friends_snapshot\", \"friends\": %d, \"ns_to_build\": %llu, "
+	       "\"ns_per_friend_read\": %.2f, \"ns_per_update\": %.2f, \"allocations\": %zu}\n",
+		num_friends, (unsigned long long)build_ns, (double)read_ns / calls, (double)update_ns / num_friends,
+		allocations);
+
+	caulk_MockSetFriends(0);
+	caulk_Shutdown();
+	return names == (size_t)num_friends * rounds && !allocations;
+}
+
+// A lobby browser showing 200 lobbies with 8 keys each, read through the wrapper every frame versus out of the lobby
+// cache, plus what refreshing one lobby after a `LobbyDataUpdate_t` costs.
+static bool bench_lobbies() {
+	static const int num_lobbies = 200, num_keys = 8, rounds = 100;
+	static const char* keys[] = {"key0", "key1", "key2", "key3", "key4", "key5", "key6", "key7"};
+
+	if (!init(false))
+		return false;
+	caulk_MockSetLobbyKeys(num_keys);
+	for (int i = 0; i < num_lobbies; i++)
+		caulk_CacheLobby(109775240917893120ull + (uint64_t)i);
+	caulk_Dispatch();
+
+	uint64_t wrapper_ns = 0, cache_ns = 0;
+	size_t wrapper_chars = 0, cache_chars = 0;
+	for (int round = 0; round < rounds; round++) {
+		uint64_t start = now_ns();
+		for (int i = 0; i < num_lobbies; i++)
+			for (int key = 0; key < num_keys; key++)
+				wrapper_chars += strlen(
+					caulk_SteamMatchmaking_GetLobbyData(109775240917893120ull + (uint64_t)i, keys[key]));
+		wrapper_ns += now_ns() - start;
+
+		start = now_ns();
+		const caulk_LobbyCache* cache = caulk_GetLobbyCache();
+		for (size_t i = 0; i < cache->count; i++) {
+			const caulk_Lobby* lobby = &cache->lobbies[i];
+			for (uint32_t pair = lobby->first_pair; pair < lobby->first_pair + lobby->num_pairs; pair++)
+				cache_chars += strlen(cache->text + cache->pairs[pair].value);
+		}
+		cache_ns += now_ns() - start;
+	}
+
+	LobbyDataUpdate_t update = {0};
+	update.m_ulSteamIDLobby = update.m_ulSteamIDMember = 109775240917893120ull;
+	update.m_bSuccess = 1;
+	uint64_t refresh_ns = 0;
+	for (int round = 0; round < rounds; round++) {
+		caulk_MockPost(LobbyDataUpdate_t_iCallback, &update, sizeof(update));
+		allocations = 0;
+		uint64_t start = now_ns();
+		caulk_Dispatch();
+		refresh_ns += now_ns() - start;
+	}
+
+	printf("{\"bench\": \"lobbies\", \"lobbies\": %d, \"keys\": %d, \"ns_per_frame_wrapper\": %.2f, "
+	       "\"ns_per_frame_cache\": %.2f, \"ns_per_refresh\": %.2f, \"allocations\": %zu}\n",
+		num_lobbies, num_keys, (double)wrapper_ns / rounds, (double)cache_ns / rounds,
+		(double)refresh_ns / rounds, allocations);
+
+	caulk_MockSetLobbyKeys(0);
+	caulk_Shutdown();
+	return wrapper_chars == cache_chars && wrapper_chars && !allocations;
+}
+
+// Reading 40 digital and 20 analog actions from each of 8 controllers, one wrapper call at a time versus in one
+// `caulk_SteamInput_PollAll()`.
+static bool bench_input() {
+	enum { num_controllers = 8, num_digital = 40, num_analog = 20, rounds = 1000 };
+	static InputHandle_t controllers[num_controllers];
+	static InputDigitalActionHandle_t digital[num_digital];
+	static InputAnalogActionHandle_t analog[num_analog];
+	static bool state[num_controllers * num_digital], wrapper_state[num_controllers * num_digital];
+	static float x[num_controllers * num_analog], wrapper_x[num_controllers * num_analog];
+
+	if (!init(false))
+		return false;
+	for (int i = 0; i < num_controllers; i++)
+		controllers[i] = 1 + (InputHandle_t)i;
+	for (int i = 0; i < num_digital; i++)
+		digital[i] = 1 + (InputDigitalActionHandle_t)i;
+	for (int i = 0; i < num_analog; i++)
+		analog[i] = 1 + (InputAnalogActionHandle_t)i;
+
+	uint64_t wrapper_ns = 0, poll_ns = 0;
+	const caulk_DigitalActionStates out_digital = {state, NULL};
+	const caulk_AnalogActionStates out_analog = {x, NULL, NULL, NULL};
+	for (int round = 0; round < rounds; round++) {
+		uint64_t start = now_ns();
+		caulk_SteamInput_RunFrame(true);
+		for (int i = 0; i < num_controllers; i++) {
+			for (int j = 0; j < num_digital; j++)
+				wrapper_state[i * num_digital + j]
+					= caulk_SteamInput_GetDigitalActionData(controllers[i], digital[j]).bState;
+			for (int j = 0; j < num_analog; j++)
+				wrapper_x[i * num_analog + j]
+					= caulk_SteamInput_GetAnalogActionData(controllers[i], analog[j]).x;
+		}
+		wrapper_ns += now_ns() - start;
+
+		start = now_ns();
+		caulk_SteamInput_PollAll(controllers, num_controllers, digital, num_digital, analog, num_analog,
+			&out_digital, &out_analog);
+		poll_ns += now_ns() - start;
+	}
+
+	printf("{\"bench\": \"input\", \"controllers\": %d, \"actions\": %d, \"ns_per_frame_wrapper\": %.2f, "
+	       "\"ns_per_frame_poll_all\": %.2f}\n",
+		num_controllers, num_digital + num_analog, (double)wrapper_ns / rounds, (double)poll_ns / rounds);
+
+	caulk_Shutdown();
+	return true;
+}
+
+// Gameplay-rate stat updates through the write-behind cache: setting a stat should cost about as much as an array
+// store, and storing 64 changed stats once per round goes through Steam's flat API instead.
+static bool bench_stats() {
+	static const int num_stats = 64, rounds = 100, updates = 64 * 160; // so every stat gets set as often
+	static caulk_Stat stats[64];
+
+	if (!init(false))
+		return false;
+	for (int i = 0; i < num_stats; i++) {
+		char name[32];
+		snprintf(name, sizeof(name), "stat_%d", i);
+		stats[i] = caulk_RegisterStat(name, caulk_StatInt32);
+	}
+
+	uint64_t set_ns = 0, store_ns = 0;
+	size_t warm_allocations = 0;
+	for (int round = 0; round < rounds; round++) {
+		allocations = 0;
+		uint64_t start = now_ns();
+		for (int i = 0; i < updates; i++)
+			caulk_SetStatInt32(stats[i % num_stats], round * updates + i);
+		set_ns += now_ns() - start;
+
+		caulk_StoreStats();
+		start = now_ns();
+		caulk_Dispatch();
+		store_ns += now_ns() - start;
+		caulk_Dispatch(); // picks up `UserStatsStored_t`
+		if (round)
+			warm_allocations += allocations;
+	}
+
+	int32_t last = 0;
+	caulk_SteamUserStats_GetStatInt32("stat_63", &last);
+	printf("{\"bench\": \"stats\", \"stats\": %d, \"ns_per_set\": %.2f, \"ns_per_store\": %.2f, "
+	       "\"allocations\": %zu}\n",
+		num_stats, (double)set_ns / ((double)updates * rounds), (double)store_ns / rounds, warm_allocations);
+
+	caulk_Shutdown();
+	return last == (rounds - 1) * updates + updates - 1 && !warm_allocations;
+}
+
+// Threaded mode under a sustained load of about 100k callbacks per second (100 per 1 ms pump frame).
+// The mock numbers the streamed messages, so a gap or a step back means the queue lost or reordered one.
+typedef struct {
+	uint64_t next;
+	size_t handled, out_of_order;
+} Sequence;
+
+static void on_sequenced(void* data, void* ctx) {
+	Sequence* sequence = (Sequence*)ctx;
+	uint64_t number;
+	memcpy(&number, data, sizeof(number));
+	sequence->out_of_order += number != sequence->next;
+	sequence->next = number + 1, sequence->handled++;
+}
+
+// Streams well past the 100k messages/s the threaded mode has to keep up with, so pump and sleep jitter can't pull
+// it under.
+static bool bench_threaded() {
+	static const size_t target = 200000;
+	static char payload[64] = {0};
+
+	if (!init(true))
+		return false;
+
+	Sequence sequence = {0};
+	caulk_RegisterCtx(BENCH_CALLBACK, on_sequenced, &sequence);
+	caulk_MockStream(BENCH_CALLBACK, payload, sizeof(payload), 300);
+
+	uint64_t start = now_ns(), dispatch_ns = 0, timeout = start + 10ull * 1000000000u;
+	size_t dispatches = 0;
+	while (sequence.handled < target && now_ns() < timeout) {
+		uint64_t before = now_ns();
+		caulk_Dispatch();
+		dispatch_ns += now_ns() - before, dispatches++;
+		sleep_ms(1);
+	}
+	uint64_t elapsed = now_ns() - start;
+	caulk_MockStream(BENCH_CALLBACK, NULL, 0, 0);
+
+	double per_sec = (double)sequence.handled * 1e9 / (double)elapsed;
+	printf("{\"bench\": \"threaded\", \"messages\": %zu, \"messages_per_sec\": %.0f, \"ns_per_dispatch\": %.2f, "
+	       "\"out_of_order\": %zu}\n",
+		sequence.handled, per_sec, (double)dispatch_ns / (double)dispatches, sequence.out_of_order);
+
+	caulk_Shutdown();
+	return sequence.handled >= target && per_sec >= 100000 && !sequence.out_of_order;
+}
+
+typedef struct {
+	const char* name;
+	bool (*run)();
+} Bench;
+
+static const Bench benches[] = {
+	{"dispatch_10",       bench_dispatch_small   },
+	{"dispatch_500",      bench_dispatch_medium  },
+	{"dispatch_2000",     bench_dispatch_large   },
+	{"dispatch_slot",     bench_dispatch_slot    },
+	{"dispatch_coalesce", bench_dispatch_coalesce},
+	{"resolve",           bench_resolve          },
+	{"poll",              bench_poll             },
+	{"timeouts",          bench_timeouts         },
+	{"wrappers",          bench_wrappers         },
+	{"friends_snapshot",  bench_friends_snapshot },
+	{"lobbies",           bench_lobbies          },
+	{"input",             bench_input            },
+	{"stats",             bench_stats            },
+	{"threaded",          bench_threaded         },
+};
+
+int main(int argc, char* argv[]) {
+	bool ok = true;
+	for (size_t i = 0; i < LENGTH(benches); i++) {
+		bool selected = argc < 2;
+		for (int j = 1; j < argc; j++)
+			selected |= !strcmp(argv[j], benches[i].name);
+
+		if (selected && !benches[i].run()) {
+			fprintf(stderr, "ERROR: %s failed\n", benches[i].name);
+			ok = false;
+		}
+	}
+
+	return ok ? EXIT_SUCCESS : EXIT_FAILURE;
+}
@@ -23,111 +23,1371 @@
 //
 // For more information, please refer to <https://unlicense.org>
 
-#include <steam_api.h>
+#include <atomic>
+#include <chrono>
+#include <stdlib.h>
 
-#define CAULK_INTERNAL
-#include "caulk.h"
-
-#define LENGTH(expr) (sizeof((expr)) / sizeof(*(expr)))
+#include "internal.h"
 
 extern "C" {
-static void on_call_completed(void*);
 
-bool caulk_Init() {
-	bool result = SteamAPI_Init();
-	if (result) {
-		SteamAPI_ManualDispatch_Init();
-		caulk_Register(SteamAPICallCompleted_t_iCallback, on_call_completed);
-	}
-	return result;
+static void* default_alloc(size_t size, void* userdata) {
+	(void)userdata;
+	return malloc(size);
 }
 
-void caulk_Shutdown() {
-	SteamAPI_Shutdown();
+static void default_dealloc(void* ptr, void* userdata) {
+	(void)userdata;
+	free(ptr);
 }
 
+caulk_Config caulk_config = {0};
+
 typedef struct {
-	caulk_ResultHandler fn;
-	SteamAPICall_t call;
-	bool registered;
-} ResultHandler;
+	caulk_CallbackHandlerCtx fn; // `NULL` once unregistered mid-dispatch
+	void* ctx;
+	uint32_t handle;
+} Subscriber;
 
 typedef struct {
-	caulk_CallbackHandler fn;
-	uint32_t callback;
+	uint64_t key; // call handle or callback ID
+	union {
+		struct {
+			caulk_ResultHandlerCtx fn;
+			void* ctx;
+			uint32_t handle;
+			int32_t callback; // the call result the handler expects, 0 for any
+		} result;
+
+		// Every subscriber to one callback ID, packed so that dispatching is a single loop. Removal swaps
+		// the last subscriber into the gap, except while the list is being dispatched: then the entry is
+		// blanked out and the list is compacted once dispatch is done with it.
+		struct {
+			Subscriber* subs;
+			uint32_t count, capacity, iterating, dead;
+		} callback;
+
+		struct {
+			size_t offset; // where the call's record is in `result_cache`
+		} cached;
+	} as;
 	bool registered;
-} CallbackHandler;
-
-#define COUNT (2048)
-static ResultHandler result_handlers[COUNT] = {0};
-static CallbackHandler callback_handlers[COUNT] = {0};
-#undef COUNT
-
-void caulk_Resolve(SteamAPICall_t call, caulk_ResultHandler handler) {
-	for (size_t idx = 0; idx < LENGTH(result_handlers); idx++) {
-		ResultHandler* iter = &result_handlers[idx];
-		if (!iter->registered) {
-			iter->fn = handler, iter->call = call;
-			iter->registered = true;
+} Handler;
+
+// Open-addressed with linear probing and backward-shift removal, so inserting, looking up and removing a handler are
+// all a short probe. The slots come from the configured allocator and the table doubles once it's 3/4 full.
+typedef struct {
+	Handler* slots;
+	size_t capacity, count;
+} HandlerTable;
+
+static HandlerTable result_handlers = {0}, callback_handlers = {0};
+
+// Callbacks listed in `steam_api.json` each have a slot the generator picked for them, so finding their handlers is a
+// lookup in a generated array and an index. The table only holds callback IDs the SDK doesn't know about.
+static Handler slot_handlers[CAULK_CALLBACK_SLOTS];
+
+// Call results are copied here before their handler runs. It starts out big enough for every known call result and
+// only grows if Steam hands us something bigger, so completing a call doesn't allocate.
+static void* result_buffer = NULL;
+static size_t result_buffer_size = 0;
+
+// A callback fetched past the budget waits for the next dispatch, copied into `held_payload` or, failing that, unfreed
+// in the pipe (and then the next dispatch mustn't run a frame first).
+enum {
+	heldNone,
+	heldCopy,
+	heldInPipe,
+};
+
+static CallbackMsg_t held_callback;
+static int held = heldNone;
+static void* held_payload = NULL;
+static size_t held_payload_size = 0;
+
+enum {
+	handleFree,
+	handleCallback,
+	handleResult,
+};
+
+// `caulk_Handle`s point here: the low half is the slot index, the high half is the slot's generation at the time it
+// was handed out, which goes stale as soon as the slot is released.
+typedef struct {
+	uint64_t key;
+	uint32_t generation, index; // `index` is the position in a callback's subscriber list, or the next free slot
+	uint8_t kind;
+
+	// a call result's timeout, linked into one of the timer wheel's buckets while it's armed
+	uint64_t deadline;
+	uint32_t prev, next;
+	uint16_t bucket;
+} HandleSlot;
+
+#define NO_TIMER (UINT16_MAX)
+#define NO_HANDLE (UINT32_MAX)
+
+static HandleSlot* handles = NULL;
+static uint32_t handle_capacity = 0, free_handle = 0;
+
+static void* reallocate(void* ptr, size_t old_size, size_t new_size) {
+	void* mem = caulk_config.alloc(new_size, caulk_config.userdata);
+	if (!mem)
+		return NULL;
+
+	if (ptr) {
+		memcpy(mem, ptr, old_size < new_size ? old_size : new_size);
+		caulk_config.dealloc(ptr, caulk_config.userdata);
+	}
+	return mem;
+}
+
+bool caulk_grow_array(void* array, size_t size, size_t old_count, size_t new_count) {
+	void* mem = reallocate(*(void**)array, old_count * size, new_count * size);
+	if (!mem)
+		return false;
+	*(void**)array = mem;
+	return true;
+}
+
+static bool grow_handles(uint32_t capacity) {
+	HandleSlot* mem = (HandleSlot*)reallocate(
+		handles, handle_capacity * sizeof(HandleSlot), capacity * sizeof(HandleSlot));
+	if (!mem)
+		return false;
+
+	// only called once the free list is empty, so the new slots make up the whole list, lowest index first
+	free_handle = capacity;
+	for (uint32_t idx = capacity; idx-- > handle_capacity;) {
+		mem[idx].kind = handleFree, mem[idx].generation = 1, mem[idx].bucket = NO_TIMER;
+		mem[idx].index = free_handle, free_handle = idx;
+	}
+
+	handles = mem, handle_capacity = capacity;
+	return true;
+}
+
+static bool acquire_handle(uint8_t kind, uint64_t key, uint32_t* out) {
+	if (free_handle == handle_capacity && !grow_handles(handle_capacity ? handle_capacity * 2 : 64))
+		return false;
+
+	uint32_t idx = free_handle;
+	free_handle = handles[idx].index;
+	handles[idx].kind = kind, handles[idx].key = key, handles[idx].bucket = NO_TIMER;
+	*out = idx;
+	return true;
+}
+
+static void release_handle(uint32_t idx) {
+	HandleSlot* slot = &handles[idx];
+	slot->kind = handleFree;
+	if (!++slot->generation)
+		slot->generation = 1;
+	slot->index = free_handle, free_handle = idx;
+}
+
+static caulk_Handle make_handle(uint32_t idx) {
+	return ((caulk_Handle)handles[idx].generation << 32) | idx;
+}
+
+static HandleSlot* lookup_handle(caulk_Handle handle) {
+	uint32_t idx = (uint32_t)handle, generation = (uint32_t)(handle >> 32);
+	if (idx >= handle_capacity || handles[idx].kind == handleFree || handles[idx].generation != generation)
+		return NULL;
+	return &handles[idx];
+}
+
+static void free_handles() {
+	if (handles)
+		caulk_config.dealloc(handles, caulk_config.userdata);
+	handles = NULL, handle_capacity = free_handle = 0;
+}
+
+// Call result timeouts live in a hierarchical timer wheel with 1 ms ticks. A timer sits in the lowest level its
+// deadline fits and drops down a level as the wheel reaches its bucket; deadlines past the top wait in its last bucket.
+#define TIMER_BITS 6
+#define TIMER_SLOTS (1 << TIMER_BITS)
+#define TIMER_LEVELS 4
+#define EXPIRED_TIMERS (TIMER_LEVELS * TIMER_SLOTS) // the bucket timers wait in while their handlers run
+
+static uint32_t timer_buckets[EXPIRED_TIMERS + 1];
+static uint64_t timer_tick = 0;
+static size_t armed_timers = 0;
+static std::chrono::steady_clock::time_point timer_start;
+
+static void link_timer(uint32_t idx, uint16_t bucket) {
+	HandleSlot* slot = &handles[idx];
+	slot->bucket = bucket, slot->prev = NO_HANDLE, slot->next = timer_buckets[bucket];
+	if (slot->next != NO_HANDLE)
+		handles[slot->next].prev = idx;
+	timer_buckets[bucket] = idx;
+}
+
+static void unlink_timer(uint32_t idx) {
+	HandleSlot* slot = &handles[idx];
+	if (slot->prev != NO_HANDLE)
+		handles[slot->prev].next = slot->next;
+	else
+		timer_buckets[slot->bucket] = slot->next;
+	if (slot->next != NO_HANDLE)
+		handles[slot->next].prev = slot->prev;
+	slot->bucket = NO_TIMER;
+}
+
+static void schedule_timer(uint32_t idx) {
+	uint64_t deadline = handles[idx].deadline;
+	for (int level = 0; level < TIMER_LEVELS; level++) {
+		int shift = level * TIMER_BITS;
+		if ((deadline >> (shift + TIMER_BITS)) == (timer_tick >> (shift + TIMER_BITS))) {
+			link_timer(idx, (uint16_t)(level * TIMER_SLOTS + ((deadline >> shift) & (TIMER_SLOTS - 1))));
 			return;
 		}
 	}
 
-	// shit we ran out o fslots.........
+	// the top level's bucket that comes around last
+	const int shift = (TIMER_LEVELS - 1) * TIMER_BITS;
+	uint64_t last = ((timer_tick >> shift) - 1) & (TIMER_SLOTS - 1);
+	link_timer(idx, (uint16_t)((TIMER_LEVELS - 1) * TIMER_SLOTS + last));
 }
 
-void caulk_Register(uint32_t callback, caulk_CallbackHandler handler) {
-	for (size_t idx = 0; idx < LENGTH(callback_handlers); idx++) {
-		CallbackHandler* iter = &callback_handlers[idx];
-		if (!iter->registered) {
-			iter->fn = handler, iter->callback = callback;
-			iter->registered = true;
-			return;
+uint64_t caulk_current_tick() {
+	auto elapsed = std::chrono::steady_clock::now() - timer_start;
+	return (uint64_t)std::chrono::duration_cast<std::chrono::milliseconds>(elapsed).count();
+}
+
+static void arm_timer(uint32_t idx, uint32_t timeout_ms) {
+	if (!armed_timers)
+		timer_tick = caulk_current_tick();
+
+	// the wheel only moves on dispatch, so it may well be behind; a timeout of 0 is due on its next tick
+	uint64_t deadline = caulk_current_tick() + timeout_ms;
+	handles[idx].deadline = deadline > timer_tick ? deadline : timer_tick + 1;
+	schedule_timer(idx);
+	armed_timers++;
+}
+
+static void disarm_timer(uint32_t idx) {
+	if (handles[idx].bucket == NO_TIMER)
+		return;
+	unlink_timer(idx);
+	armed_timers--;
+}
+
+static void reset_timers() {
+	for (size_t idx = 0; idx < LENGTH(timer_buckets); idx++)
+		timer_buckets[idx] = NO_HANDLE;
+	timer_tick = 0, armed_timers = 0;
+	timer_start = std::chrono::steady_clock::now();
+}
+
+// Moves the wheel up to the current tick. Every timer that came due ends up in `EXPIRED_TIMERS`, still armed, for
+// `expire_timers()` to fire.
+static void advance_timers() {
+	const uint64_t now = caulk_current_tick();
+	if (!armed_timers) {
+		timer_tick = now;
+		return;
+	}
+
+	while (timer_tick < now) {
+		timer_tick++;
+
+		// cascade from the top, so that timers dropping down more than one level on this tick still get placed
+		for (int level = TIMER_LEVELS - 1; level > 0; level--) {
+			if (timer_tick & (((uint64_t)1 << (level * TIMER_BITS)) - 1))
+				continue;
+
+			uint64_t slot = (timer_tick >> (level * TIMER_BITS)) & (TIMER_SLOTS - 1);
+			uint16_t bucket = (uint16_t)(level * TIMER_SLOTS + slot);
+			for (uint32_t idx = timer_buckets[bucket]; idx != NO_HANDLE;) {
+				uint32_t next = handles[idx].next;
+				unlink_timer(idx), schedule_timer(idx);
+				idx = next;
+			}
 		}
+
+		uint16_t due = (uint16_t)(timer_tick & (TIMER_SLOTS - 1));
+		for (uint32_t idx = timer_buckets[due]; idx != NO_HANDLE;) {
+			uint32_t next = handles[idx].next;
+			unlink_timer(idx), link_timer(idx, EXPIRED_TIMERS);
+			idx = next;
+		}
+	}
+}
+
+static size_t table_slot(const HandlerTable* table, uint64_t key) {
+	return (size_t)((key * UINT64_C(0x9E3779B97F4A7C15)) >> 32) & (table->capacity - 1);
+}
+
+static Handler* table_find(const HandlerTable* table, uint64_t key) {
+	for (size_t idx = table_slot(table, key);; idx = (idx + 1) & (table->capacity - 1)) {
+		Handler* iter = &table->slots[idx];
+		if (!iter->registered || iter->key == key)
+			return iter;
 	}
+}
+
+static bool table_init(HandlerTable* table, size_t capacity) {
+	size_t slots = 8;
+	while (slots / 4 * 3 < capacity)
+		slots *= 2;
+
+	Handler* mem = (Handler*)caulk_config.alloc(slots * sizeof(Handler), caulk_config.userdata);
+	if (!mem)
+		return false;
+	memset(mem, 0, slots * sizeof(Handler));
+
+	table->slots = mem, table->capacity = slots, table->count = 0;
+	return true;
+}
+
+static void table_free(HandlerTable* table) {
+	if (table->slots)
+		caulk_config.dealloc(table->slots, caulk_config.userdata);
+	table->slots = NULL, table->capacity = table->count = 0;
+}
+
+static bool table_grow(HandlerTable* table) {
+	HandlerTable old = *table;
+	if (!table_init(table, old.capacity))
+		return *table = old, false;
+
+	for (size_t idx = 0; idx < old.capacity; idx++)
+		if (old.slots[idx].registered)
+			*table_find(table, old.slots[idx].key) = old.slots[idx], table->count++;
+
+	table_free(&old);
+	return true;
+}
+
+// Returns the handler slot for `key`, which is already registered if the key was taken. Returns `NULL` only if the
+// table needed to grow and the allocator gave up.
+static Handler* table_insert(HandlerTable* table, uint64_t key) {
+	if (!table->slots)
+		return NULL;
+	if (table->count >= table->capacity / 4 * 3 && !table_grow(table))
+		return NULL;
+
+	Handler* iter = table_find(table, key);
+	if (!iter->registered)
+		iter->key = key;
+	return iter;
+}
+
+static void table_remove(HandlerTable* table, Handler* slot) {
+	const size_t mask = table->capacity - 1;
+	size_t hole = slot - table->slots;
+
+	for (size_t idx = (hole + 1) & mask;; idx = (idx + 1) & mask) {
+		Handler* iter = &table->slots[idx];
+		if (!iter->registered)
+			break;
+
+		// shift the entry back into the hole unless that would move it before its home slot
+		size_t home = table_slot(table, iter->key);
+		if (((idx - home) & mask) >= ((idx - hole) & mask))
+			table->slots[hole] = *iter, hole = idx;
+	}
+
+	table->slots[hole].registered = false;
+	table->count--;
+}
+
+static void* reserve_result_buffer(size_t size) {
+	if (size <= result_buffer_size)
+		return result_buffer;
+
+	void* mem = caulk_config.alloc(size, caulk_config.userdata);
+	if (!mem)
+		return NULL;
+
+	if (result_buffer)
+		caulk_config.dealloc(result_buffer, caulk_config.userdata);
+	result_buffer = mem, result_buffer_size = size;
+	return mem;
+}
+
+static void free_result_buffer() {
+	if (result_buffer)
+		caulk_config.dealloc(result_buffer, caulk_config.userdata);
+	result_buffer = NULL, result_buffer_size = 0;
+}
+
+static void free_held_payload() {
+	if (held_payload)
+		caulk_config.dealloc(held_payload, caulk_config.userdata);
+	held_payload = NULL, held_payload_size = 0, held = heldNone;
+}
+
+// Call results nobody resolved wait here for `caulk_Poll()`, in a ring of `result_cache_size` bytes that pushes out the
+// oldest when full. The last `EVICTED_CALLS` calls pushed out stay in `cached_results` as tombstones.
+typedef struct {
+	SteamAPICall_t call;
+	uint64_t frame; // `dispatch_frames` when the result came in
+	int32_t callback;
+	uint32_t size;
+	bool io_failed, live, wrap;
+} CachedHeader;
+
+#define CACHED_SIZE(size) (sizeof(CachedHeader) + PADDED(size))
+#define EVICTED_CALLS (256)
+#define EVICTED_RESULT SIZE_MAX // the offset a tombstone has in `cached_results`
+
+static uint8_t* result_cache = NULL;
+static size_t cache_head = 0, cache_tail = 0;
+static HandlerTable cached_results = {0};
+static uint64_t dispatch_frames = 0;
+static SteamAPICall_t evicted_calls[EVICTED_CALLS];
+static size_t evicted_head = 0;
+
+// Returns the oldest record, skipping over the space left at the end of the ring, or `NULL` if the cache is empty.
+static CachedHeader* oldest_result() {
+	while (cache_tail != cache_head) {
+		size_t size = caulk_config.result_cache_size, offset = cache_tail % size, left = size - offset;
+		CachedHeader* record = reinterpret_cast<CachedHeader*>(result_cache + offset);
+		if (left >= sizeof(CachedHeader) && !record->wrap)
+			return record;
+		cache_tail += left;
+	}
+	return NULL;
+}
+
+// Turns a call's entry into a tombstone, forgetting the oldest one if there are `EVICTED_CALLS` already.
+static void evict_result(SteamAPICall_t call) {
+	SteamAPICall_t* slot = &evicted_calls[evicted_head++ % EVICTED_CALLS];
+	if (*slot) {
+		Handler* old = table_find(&cached_results, *slot);
+		if (old->registered && old->as.cached.offset == EVICTED_RESULT)
+			table_remove(&cached_results, old);
+	}
+
+	*slot = call;
+	table_find(&cached_results, call)->as.cached.offset = EVICTED_RESULT;
+}
+
+static void drop_result(CachedHeader* record) {
+	if (record->live)
+		evict_result(record->call);
+	cache_tail += CACHED_SIZE(record->size);
+}
+
+static void cache_result(SteamAPICall_t call, int32_t callback, const void* data, uint32_t size, bool io_failed) {
+	const size_t need = CACHED_SIZE(size), cache_size = caulk_config.result_cache_size;
+	if (!result_cache || need > cache_size)
+		return;
+
+	size_t skip;
+	for (;;) {
+		if (cache_head == cache_tail)
+			cache_head = cache_tail = 0;
+
+		size_t offset = cache_head % cache_size;
+		skip = cache_size - offset;
+		if (skip >= need)
+			skip = 0;
+		if (cache_size - (cache_head - cache_tail) >= skip + need)
+			break;
+
+		CachedHeader* oldest = oldest_result();
+		if (oldest)
+			drop_result(oldest);
+	}
+
+	Handler* iter = table_insert(&cached_results, call);
+	if (!iter || iter->registered)
+		return;
+
+	if (skip >= sizeof(CachedHeader))
+		reinterpret_cast<CachedHeader*>(result_cache + cache_head % cache_size)->wrap = true;
+	cache_head += skip;
+
+	CachedHeader* record = reinterpret_cast<CachedHeader*>(result_cache + cache_head % cache_size);
+	*record = {call, dispatch_frames, callback, size, io_failed, true, false};
+	if (data)
+		memcpy(record + 1, data, size);
+
+	iter->as.cached.offset = cache_head % cache_size, iter->registered = true;
+	cached_results.count++;
+	cache_head += need;
+}
+
+static void expire_results() {
+	dispatch_frames++;
+	if (!result_cache || !caulk_config.result_cache_frames)
+		return;
+
+	CachedHeader* record;
+	while ((record = oldest_result()) && dispatch_frames - record->frame >= caulk_config.result_cache_frames)
+		drop_result(record);
+}
+
+static void free_result_cache() {
+	if (result_cache)
+		caulk_config.dealloc(result_cache, caulk_config.userdata);
+	result_cache = NULL, cache_head = cache_tail = 0, dispatch_frames = 0;
+	memset(evicted_calls, 0, sizeof(evicted_calls)), evicted_head = 0;
+	table_free(&cached_results);
+}
+
+// Coalesced callbacks keep only their latest payload per callback ID and key (the SteamIDs `caulk_coalesce_rules`
+// points at), flags ORed together, and go to their handlers in arrival order at the end of the dispatch.
+typedef struct {
+	uint64_t key[2];
+	int32_t callback;
+	uint32_t size, bucket;
+	size_t offset; // the payload, in `coalesce_payloads`
+	bool delivered; // early, see `coalesce()`
+} Coalesced;
+
+static bool coalescing[CAULK_CALLBACK_SLOTS];
+static Coalesced* coalesced = NULL;
+static uint32_t* coalesce_index = NULL;
+static size_t num_coalesced = 0, coalesced_capacity = 0;
+static uint8_t* coalesce_payloads = NULL;
+static size_t coalesce_payloads_used = 0, coalesce_payloads_size = 0;
+
+static size_t coalesce_bucket(int32_t callback, const uint64_t key[2]) {
+	uint64_t hash = key[0] ^ (key[1] * UINT64_C(0x9E3779B97F4A7C15)) ^ (uint32_t)callback;
+	hash *= UINT64_C(0x9E3779B97F4A7C15);
+	return (size_t)(hash >> 32) & (coalesced_capacity * 2 - 1);
+}
+
+static bool grow_coalesced() {
+	size_t capacity = coalesced_capacity ? coalesced_capacity * 2 : 64;
+	Coalesced* entries = (Coalesced*)reallocate(
+		coalesced, coalesced_capacity * sizeof(Coalesced), capacity * sizeof(Coalesced));
+	if (!entries)
+		return false;
+	coalesced = entries;
+
+	uint32_t* index = (uint32_t*)caulk_config.alloc(capacity * 2 * sizeof(uint32_t), caulk_config.userdata);
+	if (!index)
+		return false;
+	if (coalesce_index)
+		caulk_config.dealloc(coalesce_index, caulk_config.userdata);
+	coalesce_index = index, coalesced_capacity = capacity;
+
+	memset(index, 0, capacity * 2 * sizeof(uint32_t));
+	for (size_t pos = 0; pos < num_coalesced; pos++) {
+		size_t bucket = coalesce_bucket(coalesced[pos].callback, coalesced[pos].key);
+		while (index[bucket])
+			bucket = (bucket + 1) & (capacity * 2 - 1);
+		index[bucket] = (uint32_t)pos + 1, coalesced[pos].bucket = (uint32_t)bucket;
+	}
+	return true;
+}
+
+static void* reserve_coalesce_payload(uint32_t size) {
+	if (coalesce_payloads_used + PADDED(size) > coalesce_payloads_size) {
+		size_t capacity = coalesce_payloads_size ? coalesce_payloads_size * 2 : 4096;
+		while (capacity < coalesce_payloads_used + PADDED(size))
+			capacity *= 2;
+
+		uint8_t* mem = (uint8_t*)reallocate(coalesce_payloads, coalesce_payloads_used, capacity);
+		if (!mem)
+			return NULL;
+		coalesce_payloads = mem, coalesce_payloads_size = capacity;
+	}
+
+	void* payload = coalesce_payloads + coalesce_payloads_used;
+	coalesce_payloads_used += PADDED(size);
+	return payload;
+}
+
+static void free_coalesced() {
+	if (coalesced)
+		caulk_config.dealloc(coalesced, caulk_config.userdata);
+	if (coalesce_index)
+		caulk_config.dealloc(coalesce_index, caulk_config.userdata);
+	if (coalesce_payloads)
+		caulk_config.dealloc(coalesce_payloads, caulk_config.userdata);
+	coalesced = NULL, coalesce_index = NULL, coalesce_payloads = NULL;
+	num_coalesced = coalesced_capacity = coalesce_payloads_used = coalesce_payloads_size = 0;
+	memset(coalescing, 0, sizeof(coalescing));
+}
+
+static void free_subscribers() {
+	for (size_t idx = 0; idx < callback_handlers.capacity; idx++) {
+		Handler* iter = &callback_handlers.slots[idx];
+		if (iter->registered && iter->as.callback.subs)
+			caulk_config.dealloc(iter->as.callback.subs, caulk_config.userdata);
+	}
+
+	for (size_t idx = 0; idx < LENGTH(slot_handlers); idx++)
+		if (slot_handlers[idx].as.callback.subs)
+			caulk_config.dealloc(slot_handlers[idx].as.callback.subs, caulk_config.userdata);
+	memset(slot_handlers, 0, sizeof(slot_handlers));
+}
+
+static Handler* find_callback(uint32_t callback) {
+	int32_t slot = caulk_CallbackSlot((int32_t)callback);
+	return slot >= 0 ? &slot_handlers[slot] : table_find(&callback_handlers, callback);
+}
+
+static void free_all() {
+	caulk_free_friends(), caulk_free_user_stats(), caulk_free_lobbies(), free_subscribers(), free_handles();
+	free_result_buffer(), free_held_payload(), free_result_cache(), free_coalesced();
+	reset_timers();
+	table_free(&result_handlers), table_free(&callback_handlers);
+}
+
+// Dispatch statistics only exist when built with `CAULK_STATS`. Otherwise every hook below is an empty inline function
+// and the dispatch path compiles to exactly what it was without them.
+#ifdef CAULK_STATS
+#define MAX_STATS_CALLBACKS 256
+
+typedef std::chrono::steady_clock::time_point StatsTime;
+
+// Callback IDs map onto a dense array through a small open-addressed index of `position + 1`, so that the array can be
+// handed out as is. IDs past `MAX_STATS_CALLBACKS` distinct ones are simply not counted.
+static caulk_CallbackStats callback_stats[MAX_STATS_CALLBACKS];
+static uint16_t stats_index[MAX_STATS_CALLBACKS * 2];
+static caulk_DispatchStats dispatch_stats = {callback_stats, 0, 0, 0, 0};
+static std::atomic<uint64_t> run_frame_ns(0); // the pump thread runs frames too
+
+static StatsTime stats_now() {
+	return std::chrono::steady_clock::now();
+}
+
+static caulk_CallbackStats* stats_for(int32_t callback) {
+	size_t idx = (size_t)(((uint64_t)(uint32_t)callback * 0x9E3779B97F4A7C15ull) >> 32) & (LENGTH(stats_index) - 1);
+	for (;; idx = (idx + 1) & (LENGTH(stats_index) - 1)) {
+		uint16_t pos = stats_index[idx];
+		if (pos && callback_stats[pos - 1].callback == (uint32_t)callback)
+			return &callback_stats[pos - 1];
+		if (pos)
+			continue;
+
+		if (dispatch_stats.num_callbacks == MAX_STATS_CALLBACKS)
+			return NULL;
+		caulk_CallbackStats* stats = &callback_stats[dispatch_stats.num_callbacks++];
+		memset(stats, 0, sizeof(*stats));
+		stats->callback = (uint32_t)callback;
+		stats_index[idx] = (uint16_t)dispatch_stats.num_callbacks;
+		return stats;
+	}
+}
+
+// Handler time goes into power-of-two microsecond buckets: under 1us, under 2us, under 4us... and everything slower
+// than the second to last bucket in the last one.
+static void stats_message(int32_t callback, uint32_t size, bool handled, StatsTime start) {
+	caulk_CallbackStats* stats = stats_for(callback);
+	if (!stats)
+		return;
+
+	stats->messages++, stats->bytes += size;
+	if (!handled) {
+		stats->unhandled++;
+		return;
+	}
+
+	uint64_t ns = (uint64_t)std::chrono::duration_cast<std::chrono::nanoseconds>(stats_now() - start).count();
+	stats->handler_ns += ns;
+
+	size_t bucket = 0;
+	for (uint64_t us = ns / 1000; us && bucket < CAULK_STATS_BUCKETS - 1; us >>= 1)
+		bucket++;
+	stats->histogram[bucket]++;
+}
+
+static void stats_dropped() {
+	dispatch_stats.dropped_registrations++;
+}
+
+static void stats_run_frame(StatsTime start) {
+	run_frame_ns.fetch_add(
+		(uint64_t)std::chrono::duration_cast<std::chrono::nanoseconds>(stats_now() - start).count(),
+		std::memory_order_relaxed);
+}
+
+static void stats_reset() {
+	memset(stats_index, 0, sizeof(stats_index));
+	dispatch_stats.num_callbacks = 0, dispatch_stats.dropped_registrations = 0;
+	run_frame_ns.store(0, std::memory_order_relaxed);
+}
+#else
+typedef int StatsTime;
+
+static inline StatsTime stats_now() {
+	return 0;
+}
 
-	// shit we ran out o fslots againds a.........
+static inline void stats_message(int32_t callback, uint32_t size, bool handled, StatsTime start) {
+	(void)callback, (void)size, (void)handled, (void)start;
 }
 
-static void handle_dispatch_result(SteamAPICall_t call, void* result, bool io_failed) {
-	for (size_t idx = 0; idx < LENGTH(result_handlers); idx++) {
-		ResultHandler* iter = &result_handlers[idx];
-		if (iter->registered && iter->call == call) {
-			iter->registered = false;
-			iter->fn(result, io_failed);
+static inline void stats_dropped() {}
+
+static inline void stats_run_frame(StatsTime start) {
+	(void)start;
+}
+
+static inline void stats_reset() {}
+#endif
+
+void caulk_run_frame(HSteamPipe steam_pipe) {
+	StatsTime start = stats_now();
+	SteamAPI_ManualDispatch_RunFrame(steam_pipe);
+	stats_run_frame(start);
+}
+
+bool caulk_InitEx(const caulk_Config* cfg) {
+	static const caulk_Config defaults = {64, 64, default_alloc, default_dealloc, NULL, false, 0, 0, 0, 0, 0, 0};
+
+	caulk_config = cfg ? *cfg : defaults;
+	if (!caulk_config.alloc || !caulk_config.dealloc)
+		caulk_config.alloc = default_alloc, caulk_config.dealloc = default_dealloc;
+	if (!caulk_config.queue_size)
+		caulk_config.queue_size = 256 * 1024;
+	if (!caulk_config.pump_interval_us)
+		caulk_config.pump_interval_us = 1000;
+	if (!caulk_config.result_cache_size)
+		caulk_config.result_cache_size = 32 * 1024;
+	caulk_config.result_cache_size &= ~(size_t)7; // keeps every record 8-byte aligned
+	if (!caulk_config.stats_store_interval_ms)
+		caulk_config.stats_store_interval_ms = 60 * 1000;
+	stats_reset(), reset_timers();
+
+	if (!table_init(&result_handlers, caulk_config.result_capacity)
+		|| !table_init(&callback_handlers, caulk_config.callback_capacity)
+		|| !grow_handles((uint32_t)(caulk_config.callback_capacity + caulk_config.result_capacity + 1))
+		|| !reserve_result_buffer(sizeof(caulk_CallResultBuffer))
+		|| !table_init(&cached_results, caulk_config.result_capacity)
+		|| !(result_cache = (uint8_t*)caulk_config.alloc(
+				 caulk_config.result_cache_size, caulk_config.userdata)))
+		goto fail;
+
+	if (!SteamAPI_Init())
+		goto fail;
+
+	SteamAPI_ManualDispatch_Init();
+	caulk_LoadInterfaces();
+	if ((caulk_config.friends_snapshot_flags && !caulk_load_friends())
+		|| (caulk_config.threaded && !caulk_start_pump())) {
+		caulk_UnloadInterfaces();
+		SteamAPI_Shutdown();
+		goto fail;
+	}
+	return true;
+
+fail:
+	free_all();
+	return false;
+}
+
+bool caulk_Init() {
+	return caulk_InitEx(NULL);
+}
+
+void caulk_Shutdown() {
+	caulk_stop_pump();
+	caulk_UnloadInterfaces();
+	SteamAPI_Shutdown();
+	free_all();
+}
+
+static caulk_Handle resolve(SteamAPICall_t call, int32_t callback, caulk_ResultHandlerCtx handler, void* ctx) {
+	if (call == k_uAPICallInvalid)
+		return 0;
+
+	Handler* iter = table_insert(&result_handlers, call);
+	if (!iter || iter->registered)
+		return 0;
+
+	uint32_t handle;
+	if (!acquire_handle(handleResult, call, &handle))
+		return 0;
+
+	iter->as.result.fn = handler, iter->as.result.ctx = ctx, iter->as.result.handle = handle;
+	iter->as.result.callback = callback;
+	iter->registered = true;
+	result_handlers.count++;
+	return make_handle(handle);
+}
+
+caulk_Handle caulk_ResolveCtx(SteamAPICall_t call, caulk_ResultHandlerCtx handler, void* ctx) {
+	caulk_Handle handle = resolve(call, 0, handler, ctx);
+	if (!handle)
+		stats_dropped();
+	return handle;
+}
+
+caulk_Handle caulk_ResolveAs(SteamAPICall_t call, uint32_t callback, caulk_ResultHandlerCtx handler, void* ctx) {
+	caulk_Handle handle = resolve(call, (int32_t)callback, handler, ctx);
+	if (!handle)
+		stats_dropped();
+	return handle;
+}
+
+// Plain handlers ride on the context variants, with the handler itself smuggled through the context pointer.
+static void call_plain_result(void* data, bool io_failed, void* fn) {
+	reinterpret_cast<caulk_ResultHandler>(fn)(data, io_failed);
+}
+
+caulk_Handle caulk_Resolve(SteamAPICall_t call, caulk_ResultHandler handler) {
+	return caulk_ResolveCtx(call, call_plain_result, reinterpret_cast<void*>(handler));
+}
+
+static void remove_result(Handler* iter) {
+	disarm_timer(iter->as.result.handle);
+	release_handle(iter->as.result.handle);
+	table_remove(&result_handlers, iter);
+}
+
+caulk_Handle caulk_ResolveWithTimeout(SteamAPICall_t call, caulk_ResultHandlerCtx handler, void* ctx,
+	uint32_t timeout_ms) {
+	caulk_Handle handle = resolve(call, 0, handler, ctx);
+	if (!handle) {
+		stats_dropped();
+		return 0;
+	}
+
+	arm_timer((uint32_t)handle, timeout_ms);
+	return handle;
+}
+
+// Gives up on every call whose timeout passed: its handler gets `NULL` and `io_failed`. Handlers may resolve, cancel
+// or time out anything, so each expired timer is taken off the list before its handler runs.
+static void expire_timers() {
+	advance_timers();
+
+	uint32_t idx;
+	while ((idx = timer_buckets[EXPIRED_TIMERS]) != NO_HANDLE) {
+		Handler* iter = table_find(&result_handlers, handles[idx].key);
+		caulk_ResultHandlerCtx fn = iter->as.result.fn;
+		void* ctx = iter->as.result.ctx;
+		remove_result(iter);
+		fn(NULL, true, ctx);
+	}
+}
+
+caulk_PollStatus caulk_Poll(SteamAPICall_t call, void* out, size_t size, bool* io_failed) {
+	if (!cached_results.slots || call == k_uAPICallInvalid)
+		return caulk_PollFailed;
+
+	Handler* iter = table_find(&cached_results, call);
+	if (!iter->registered)
+		return caulk_PollPending;
+	if (iter->as.cached.offset == EVICTED_RESULT) {
+		table_remove(&cached_results, iter);
+		return caulk_PollEvicted;
+	}
+
+	// a buffer that's too small leaves the result where it is, for another try with a bigger one
+	CachedHeader* record = reinterpret_cast<CachedHeader*>(result_cache + iter->as.cached.offset);
+	if (record->size > size)
+		return caulk_PollFailed;
+
+	record->live = false;
+	table_remove(&cached_results, iter);
+	if (io_failed)
+		*io_failed = record->io_failed;
+	memcpy(out, record + 1, record->size);
+	return caulk_PollReady;
+}
+
+bool caulk_Cancel(SteamAPICall_t call) {
+	if (!result_handlers.slots)
+		return false;
+
+	Handler* iter = table_find(&result_handlers, call);
+	if (!iter->registered)
+		return false;
+
+	remove_result(iter);
+	return true;
+}
+
+bool caulk_initialized() {
+	return callback_handlers.slots != NULL;
+}
+
+caulk_Handle caulk_subscribe(uint32_t callback, caulk_CallbackHandlerCtx handler, void* ctx) {
+	if (!caulk_initialized())
+		return 0;
+
+	int32_t slot = caulk_CallbackSlot((int32_t)callback);
+	Handler* iter = slot >= 0 ? &slot_handlers[slot] : table_insert(&callback_handlers, callback);
+	if (!iter)
+		return 0;
+
+	if (!iter->registered) {
+		memset(&iter->as.callback, 0, sizeof(iter->as.callback));
+		iter->key = callback, iter->registered = true;
+		if (slot < 0)
+			callback_handlers.count++;
+	}
+
+	if (iter->as.callback.count == iter->as.callback.capacity) {
+		uint32_t capacity = iter->as.callback.capacity ? iter->as.callback.capacity * 2 : 4;
+		Subscriber* subs = (Subscriber*)reallocate(iter->as.callback.subs,
+			iter->as.callback.capacity * sizeof(Subscriber), capacity * sizeof(Subscriber));
+		if (!subs)
+			return 0;
+		iter->as.callback.subs = subs, iter->as.callback.capacity = capacity;
+	}
+
+	uint32_t handle;
+	if (!acquire_handle(handleCallback, callback, &handle))
+		return 0;
+
+	handles[handle].index = iter->as.callback.count;
+	iter->as.callback.subs[iter->as.callback.count++] = {handler, ctx, handle};
+	return make_handle(handle);
+}
+
+caulk_Handle caulk_RegisterCtx(uint32_t callback, caulk_CallbackHandlerCtx handler, void* ctx) {
+	caulk_Handle handle = caulk_subscribe(callback, handler, ctx);
+	if (!handle)
+		stats_dropped();
+	return handle;
+}
+
+static void call_plain_callback(void* data, void* fn) {
+	reinterpret_cast<caulk_CallbackHandler>(fn)(data);
+}
+
+caulk_Handle caulk_Register(uint32_t callback, caulk_CallbackHandler handler) {
+	return caulk_RegisterCtx(callback, call_plain_callback, reinterpret_cast<void*>(handler));
+}
+
+static void compact_subscribers(Handler* iter) {
+	uint32_t count = 0;
+	for (uint32_t idx = 0; idx < iter->as.callback.count; idx++) {
+		Subscriber sub = iter->as.callback.subs[idx];
+		if (!sub.fn)
+			continue;
+		handles[sub.handle].index = count;
+		iter->as.callback.subs[count++] = sub;
+	}
+	iter->as.callback.count = count, iter->as.callback.dead = 0;
+}
+
+bool caulk_Unregister(caulk_Handle handle) {
+	HandleSlot* slot = lookup_handle(handle);
+	if (!slot)
+		return false;
+
+	if (slot->kind == handleResult) {
+		remove_result(table_find(&result_handlers, slot->key));
+		return true;
+	}
+
+	Handler* iter = find_callback((uint32_t)slot->key);
+	Subscriber* subs = iter->as.callback.subs;
+	uint32_t idx = slot->index;
+
+	if (iter->as.callback.iterating) {
+		subs[idx].fn = NULL;
+		iter->as.callback.dead++;
+	} else {
+		Subscriber last = subs[--iter->as.callback.count];
+		handles[last.handle].index = idx;
+		subs[idx] = last;
+	}
+
+	release_handle((uint32_t)handle);
+	return true;
+}
+
+// Returns whether there was anyone subscribed to `callback`.
+static bool handle_dispatch_callback(uint32_t callback, void* data) {
+	int32_t slot = caulk_CallbackSlot((int32_t)callback);
+	Handler* iter = slot >= 0 ? &slot_handlers[slot] : table_find(&callback_handlers, callback);
+	if (!iter->registered)
+		return false;
+
+	// Handlers may register or unregister anything, including their own callback, and the table can grow under us.
+	// Subscribers added by a handler wait for the next message, and a table entry is looked up again after every
+	// call (slots never move).
+	uint32_t count = iter->as.callback.count;
+	iter->as.callback.iterating++;
+	for (uint32_t idx = 0; idx < count; idx++) {
+		Subscriber sub = iter->as.callback.subs[idx];
+		if (!sub.fn)
+			continue;
+		sub.fn(data, sub.ctx);
+		if (slot < 0)
+			iter = table_find(&callback_handlers, callback);
+	}
+
+	if (!--iter->as.callback.iterating && iter->as.callback.dead)
+		compact_subscribers(iter);
+	return true;
+}
+
+bool caulk_Coalesce(uint32_t callback, bool enable) {
+	int32_t slot = caulk_CallbackSlot((int32_t)callback);
+	if (slot < 0 || caulk_coalesce_rules[slot].key[0] < 0)
+		return false;
+
+	coalescing[slot] = enable;
+	return true;
+}
+
+static void deliver_coalesced(Coalesced* entry) {
+	StatsTime start = stats_now();
+	bool handled = handle_dispatch_callback((uint32_t)entry->callback, coalesce_payloads + entry->offset);
+	stats_message(entry->callback, entry->size, handled, start);
+	entry->delivered = true;
+}
+
+// Returns whether the callback was taken; it's dispatched right away otherwise.
+static bool coalesce(int32_t slot, int32_t callback, const void* data, uint32_t size) {
+	const caulk_CoalesceRule* rule = &caulk_coalesce_rules[slot];
+	uint64_t key[2] = {0, 0};
+	for (size_t k = 0; k < LENGTH(key); k++) {
+		if (rule->key[k] < 0 || (size_t)rule->key[k] + sizeof(uint64_t) > size)
+			continue;
+		memcpy(&key[k], (const uint8_t*)data + rule->key[k], sizeof(uint64_t));
+	}
+
+	if (num_coalesced == coalesced_capacity && !grow_coalesced())
+		return false;
+
+	const size_t mask = coalesced_capacity * 2 - 1;
+	size_t bucket = coalesce_bucket(callback, key);
+	for (; coalesce_index[bucket]; bucket = (bucket + 1) & mask) {
+		Coalesced* iter = &coalesced[coalesce_index[bucket] - 1];
+		if (iter->delivered || iter->callback != callback || iter->key[0] != key[0] || iter->key[1] != key[1])
+			continue;
+
+		bool flags = rule->flags >= 0 && (size_t)rule->flags + sizeof(int32_t) <= size;
+		int32_t old_flags = 0, new_flags = 0;
+		if (flags && (size_t)rule->flags + sizeof(int32_t) <= iter->size)
+			memcpy(&old_flags, coalesce_payloads + iter->offset + rule->flags, sizeof(int32_t));
+
+		// A bigger payload moves to a new slot, leaving the old one unused until the flush. Without room for
+		// it, the old payload goes out now, so it can't arrive after the new one.
+		if (PADDED(size) > PADDED(iter->size)) {
+			void* slot = reserve_coalesce_payload(size);
+			if (!slot) {
+				deliver_coalesced(iter);
+				return false;
+			}
+			iter->offset = (size_t)((uint8_t*)slot - coalesce_payloads);
+		}
+
+		iter->size = size;
+		uint8_t* payload = coalesce_payloads + iter->offset;
+		memcpy(payload, data, size);
+		if (flags) {
+			memcpy(&new_flags, payload + rule->flags, sizeof(int32_t));
+			new_flags |= old_flags;
+			memcpy(payload + rule->flags, &new_flags, sizeof(int32_t));
+		}
+		return true;
+	}
+
+	void* payload = reserve_coalesce_payload(size);
+	if (!payload)
+		return false;
+	memcpy(payload, data, size);
+
+	coalesced[num_coalesced] = {{key[0], key[1]}, callback, size, (uint32_t)bucket,
+		(size_t)((uint8_t*)payload - coalesce_payloads), false};
+	coalesce_index[bucket] = (uint32_t)++num_coalesced;
+	return true;
+}
+
+static void flush_coalesced() {
+	for (size_t pos = 0; pos < num_coalesced; pos++) {
+		Coalesced* entry = &coalesced[pos];
+		if (!entry->delivered)
+			deliver_coalesced(entry);
+		coalesce_index[entry->bucket] = 0;
+	}
+	num_coalesced = 0, coalesce_payloads_used = 0;
+}
+
+bool caulk_handlers_fit(Sink* sink, size_t messages, size_t bytes) {
+	(void)sink, (void)messages, (void)bytes;
+	return true;
+}
+
+static void* handlers_result_buffer(Sink* sink, size_t size) {
+	(void)sink;
+	return reserve_result_buffer(size);
+}
+
+static void handlers_result(Sink* sink, SteamAPICall_t call, int32_t callback, void* data, uint32_t size,
+	bool io_failed) {
+	(void)sink;
+
+	StatsTime start = stats_now();
+	Handler* iter = table_find(&result_handlers, call);
+	if (!iter->registered) {
+		cache_result(call, callback, data, data ? size : 0, io_failed);
+		stats_message(callback, size, false, start);
+		return;
+	}
+
+	caulk_ResultHandlerCtx fn = iter->as.result.fn;
+	void* ctx = iter->as.result.ctx;
+	int32_t expected = iter->as.result.callback;
+	remove_result(iter);
+
+	// a handler typed for one call result must never see another one's bytes
+	fn(data, io_failed || (expected && expected != callback), ctx);
+	stats_message(callback, size, true, start);
+}
+
+static void handlers_callback(Sink* sink, int32_t callback, void* data, uint32_t size) {
+	(void)sink;
+	int32_t slot = caulk_CallbackSlot(callback);
+	if (slot >= 0 && coalescing[slot] && coalesce(slot, callback, data, size))
+		return;
+
+	StatsTime start = stats_now();
+	bool handled = handle_dispatch_callback((uint32_t)callback, data);
+	stats_message(callback, size, handled, start);
+}
+
+static Sink handler_sink = {caulk_handlers_fit, handlers_result_buffer, handlers_result, handlers_callback};
+
+typedef struct {
+	Sink sink;
+	caulk_Event* events;
+	size_t capacity, count;
+	uint8_t* arena;
+	size_t arena_size, arena_used;
+} EventSink;
+
+// An empty batch takes anything, or a message too big for the buffers would block everything behind it. Whatever
+// doesn't fit then goes without: a payload is left `NULL`, and an event past `capacity` is dropped.
+static bool events_fit(Sink* sink, size_t messages, size_t bytes) {
+	EventSink* events = reinterpret_cast<EventSink*>(sink);
+	if (!events->count)
+		return true;
+	return events->count + messages <= events->capacity && events->arena_used + bytes <= events->arena_size;
+}
+
+static void* events_result_buffer(Sink* sink, size_t size) {
+	EventSink* events = reinterpret_cast<EventSink*>(sink);
+	if (events->arena_used + PADDED(size) > events->arena_size)
+		return NULL;
+
+	void* data = events->arena + events->arena_used;
+	events->arena_used += PADDED(size);
+	return data;
+}
+
+static void events_result(Sink* sink, SteamAPICall_t call, int32_t callback, void* data, uint32_t size,
+	bool io_failed) {
+	EventSink* events = reinterpret_cast<EventSink*>(sink);
+
+	// nothing is going to call a handler for this one now
+	Handler* iter = table_find(&result_handlers, call);
+	if (iter->registered)
+		remove_result(iter);
+	if (events->count == events->capacity)
+		return;
+
+	// results popped off the threaded mode's queue haven't been copied into the arena yet
+	uint8_t* arena = events->arena;
+	if (data && ((uint8_t*)data < arena || (uint8_t*)data >= arena + events->arena_size)) {
+		void* copy = events_result_buffer(sink, size);
+		data = copy ? memcpy(copy, data, size) : NULL;
+	}
+
+	events->events[events->count++] = {call, data, (uint32_t)callback, size, io_failed || !data};
+}
+
+static void events_callback(Sink* sink, int32_t callback, void* data, uint32_t size) {
+	EventSink* events = reinterpret_cast<EventSink*>(sink);
+	if (events->count == events->capacity)
+		return; // a completed call's own event, when there's only room for its result
+
+	void* copy = events_result_buffer(sink, size);
+	if (copy)
+		memcpy(copy, data, size);
+	events->events[events->count++] = {k_uAPICallInvalid, copy, (uint32_t)callback, size, false};
+}
+
+// Sets `*copied` if the callback is a held copy, which has nothing left to free in the pipe.
+static bool next_callback(HSteamPipe steam_pipe, CallbackMsg_t* callback, bool* copied) {
+	*copied = held == heldCopy;
+	if (held != heldNone) {
+		*callback = held_callback, held = heldNone;
+		return true;
+	}
+	return SteamAPI_ManualDispatch_GetNextCallback(steam_pipe, callback);
+}
+
+static void hold_callback(HSteamPipe steam_pipe, const CallbackMsg_t* callback, bool copied) {
+	held_callback = *callback, held = heldCopy;
+	if (copied)
+		return;
+
+	size_t size = (size_t)callback->m_cubParam;
+	if (size > held_payload_size) {
+		void* mem = caulk_config.alloc(size, caulk_config.userdata);
+		if (!mem) {
+			held = heldInPipe;
 			return;
 		}
+		if (held_payload)
+			caulk_config.dealloc(held_payload, caulk_config.userdata);
+		held_payload = mem, held_payload_size = size;
+	}
+
+	held_callback.m_pubParam = (uint8*)memcpy(held_payload, callback->m_pubParam, size);
+	SteamAPI_ManualDispatch_FreeLastCallback(steam_pipe);
+}
+
+// A completed call brings its result along, which goes first: that's how the result handler always ran before any
+// subscriber to `SteamAPICallCompleted_t` did.
+void caulk_dispatch_message(Sink* sink, HSteamPipe steam_pipe, const CallbackMsg_t* callback) {
+	if (callback->m_iCallback == SteamAPICallCompleted_t_iCallback) {
+		const SteamAPICallCompleted_t* completed
+			= reinterpret_cast<const SteamAPICallCompleted_t*>(callback->m_pubParam);
+
+		SteamAPICall_t call = completed->m_hAsyncCall;
+		int32_t id = completed->m_iCallback;
+		uint32_t size = completed->m_cubParam;
+
+		// with nowhere to put the result, whoever's waiting for it still hears that the call failed
+		bool failed = false;
+		void* call_result = sink->result_buffer(sink, size);
+		if (!call_result)
+			sink->result(sink, call, id, NULL, size, true);
+		else if (SteamAPI_ManualDispatch_GetAPICallResult(
+				 steam_pipe, call, call_result, (int)size, id, &failed))
+			sink->result(sink, call, id, call_result, size, failed);
 	}
+
+	sink->callback(sink, callback->m_iCallback, callback->m_pubParam, (uint32_t)callback->m_cubParam);
+}
+
+static bool message_fits(Sink* sink, const CallbackMsg_t* callback) {
+	size_t messages = 1, bytes = PADDED(callback->m_cubParam);
+	if (callback->m_iCallback == SteamAPICallCompleted_t_iCallback) {
+		const SteamAPICallCompleted_t* completed
+			= reinterpret_cast<const SteamAPICallCompleted_t*>(callback->m_pubParam);
+		messages++, bytes += PADDED(completed->m_cubParam);
+	}
+	return sink->fits(sink, messages, bytes);
+}
+
+bool caulk_over_budget(std::chrono::steady_clock::time_point start, uint32_t max_us, size_t max_callbacks,
+	size_t dispatched) {
+	if (max_callbacks && dispatched >= max_callbacks)
+		return true;
+	return max_us && dispatched && std::chrono::steady_clock::now() - start >= std::chrono::microseconds(max_us);
 }
 
-static void on_call_completed(void* data) {
+static bool dispatch_pipe(Sink* sink, uint32_t max_us, size_t max_callbacks) {
 	HSteamPipe steam_pipe = SteamAPI_GetHSteamPipe();
+	if (held != heldInPipe)
+		caulk_run_frame(steam_pipe);
 
-	SteamAPICallCompleted_t* callback = reinterpret_cast<SteamAPICallCompleted_t*>(data);
-	void* call_result = malloc(callback->m_cubParam); // TODO: just use a static allocation?
+	const auto start = std::chrono::steady_clock::now();
+	for (size_t dispatched = 0;; dispatched++) {
+		CallbackMsg_t callback;
+		bool copied = false;
+		if (!next_callback(steam_pipe, &callback, &copied))
+			return false;
 
-	bool failed = false;
-	if (SteamAPI_ManualDispatch_GetAPICallResult(steam_pipe, callback->m_hAsyncCall, call_result,
-		    (int)callback->m_cubParam, callback->m_iCallback, &failed))
-		handle_dispatch_result(callback->m_hAsyncCall, call_result, failed);
+		if (caulk_over_budget(start, max_us, max_callbacks, dispatched) || !message_fits(sink, &callback)) {
+			hold_callback(steam_pipe, &callback, copied);
+			return true;
+		}
+
+		caulk_dispatch_message(sink, steam_pipe, &callback);
+		if (!copied)
+			SteamAPI_ManualDispatch_FreeLastCallback(steam_pipe);
+	}
+}
+
+static bool dispatch(Sink* sink, uint32_t max_us, size_t max_callbacks) {
+	expire_results();
+	if (caulk_pumping())
+		return caulk_dispatch_queue(sink, max_us, max_callbacks);
+	return dispatch_pipe(sink, max_us, max_callbacks);
+}
 
-	free(call_result);
+// Timeouts go last, so that a result that's already waiting in the queue gets delivered rather than timed out.
+bool caulk_DispatchBudget(uint32_t max_us, size_t max_callbacks) {
+	bool left = dispatch(&handler_sink, max_us, max_callbacks);
+	flush_coalesced(), expire_timers(), caulk_store_user_stats(), caulk_refresh_lobbies();
+	return left;
 }
 
 void caulk_Dispatch() {
-	HSteamPipe steam_pipe = SteamAPI_GetHSteamPipe();
-	SteamAPI_ManualDispatch_RunFrame(steam_pipe);
+	dispatch(&handler_sink, 0, 0);
+	flush_coalesced(), expire_timers(), caulk_store_user_stats(), caulk_refresh_lobbies();
+}
 
-	CallbackMsg_t callback;
-	while (SteamAPI_ManualDispatch_GetNextCallback(steam_pipe, &callback)) {
-		for (size_t idx = 0; idx < LENGTH(result_handlers); idx++) {
-			CallbackHandler* iter = &callback_handlers[idx];
-			if (iter->registered && iter->callback == callback.m_iCallback) {
-				iter->fn(callback.m_pubParam);
-				break;
-			}
+size_t caulk_DispatchInto(caulk_Event* out, size_t capacity, void* payload_arena, size_t arena_size) {
+	if (!capacity)
+		return 0;
+
+	// keep every payload 8-byte aligned, wherever the arena starts
+	size_t pad = PADDED((uintptr_t)payload_arena) - (uintptr_t)payload_arena;
+	if (pad > arena_size)
+		pad = arena_size;
+
+	EventSink events = {
+		{events_fit, events_result_buffer, events_result, events_callback},
+		out, capacity, 0,
+		(uint8_t*)payload_arena + pad, arena_size - pad, 0,
+	};
+	dispatch(&events.sink, 0, 0);
+	return events.count;
+}
+
+const caulk_DispatchStats* caulk_GetDispatchStats() {
+#ifdef CAULK_STATS
+	dispatch_stats.pending_results = result_handlers.count;
+	dispatch_stats.run_frame_ns = run_frame_ns.load(std::memory_order_relaxed);
+	return &dispatch_stats;
+#else
+	return NULL;
+#endif
+}
+
+void caulk_ResetDispatchStats() {
+	stats_reset();
+}
+
+// One `RunFrame()` and then every action of every controller straight through the flat API, rather than a thunk and a
+// struct copy for each. Outputs are controller-major: action `a` of controller `c` is at `c * num_actions + a`.
+bool caulk_SteamInput_PollAll(const InputHandle_t* controllers, size_t num_controllers,
+	const InputDigitalActionHandle_t* digital_actions, size_t num_digital,
+	const InputAnalogActionHandle_t* analog_actions, size_t num_analog,
+	const caulk_DigitalActionStates* out_digital, const caulk_AnalogActionStates* out_analog) {
+	ISteamInput* iface = caulk_gSteamInput;
+	if (!iface)
+		return false;
+	SteamAPI_ISteamInput_RunFrame(iface, true);
+
+	for (size_t controller = 0; controller < num_controllers; controller++) {
+		InputHandle_t handle = controllers[controller];
+
+		for (size_t action = 0; out_digital && action < num_digital; action++) {
+			InputDigitalActionData_t data
+				= SteamAPI_ISteamInput_GetDigitalActionData(iface, handle, digital_actions[action]);
+			size_t idx = controller * num_digital + action;
+			if (out_digital->state)
+				out_digital->state[idx] = data.bState;
+			if (out_digital->active)
+				out_digital->active[idx] = data.bActive;
+		}
+
+		for (size_t action = 0; out_analog && action < num_analog; action++) {
+			InputAnalogActionData_t data
+				= SteamAPI_ISteamInput_GetAnalogActionData(iface, handle, analog_actions[action]);
+			size_t idx = controller * num_analog + action;
+			if (out_analog->x)
+				out_analog->x[idx] = data.x;
+			if (out_analog->y)
+				out_analog->y[idx] = data.y;
+			if (out_analog->mode)
+				out_analog->mode[idx] = (int32_t)data.eMode;
+			if (out_analog->active)
+				out_analog->active[idx] = data.bActive;
 		}
-		SteamAPI_ManualDispatch_FreeLastCallback(steam_pipe);
 	}
+	return true;
 }
 }
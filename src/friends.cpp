@@ -0,0 +1,295 @@
+// This is free and unencumbered software released into the public domain.
+//
+// Anyone is free to copy, modify, publish, use, compile, sell, or
+// distribute this software, either in source code form or as a compiled
+// binary, for any purpose, commercial or non-commercial, and by any
+// means.
+//
+// In jurisdictions that recognize copyright laws, the author or authors
+// of this software dedicate any and all copyright interest in the
+// software to the public domain. We make this dedication for the benefit
+// of the public at large and to the detriment of our heirs and
+// successors. We intend this dedication to be an overt act of
+// relinquishment in perpetuity of all present and future rights to this
+// software under copyright law.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+// EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+// MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+// IN NO EVENT SHALL THE AUTHORS BE LIABLE FOR ANY CLAIM, DAMAGES OR
+// OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE,
+// ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR
+// OTHER DEALINGS IN THE SOFTWARE.
+//
+// For more information, please refer to <https://unlicense.org>
+
+#include <stdlib.h>
+
+#include "internal.h"
+
+extern "C" {
+// Every friend matching `friends_snapshot_flags`, one array per field, kept current by a `PersonaStateChange_t`
+// subscriber. Names live back to back in `text`; changed positions pile up in `dirty_list` until they're cleared.
+typedef struct {
+	caulk_FriendsSnapshot view;
+	size_t capacity;
+	uint64_t *ids, *games, *lobbies;
+	uint32_t* names;
+	int32_t* persona_states;
+
+	uint32_t* index; // open-addressed by SteamID, `position + 1`, twice `capacity` slots
+	bool* dirty;
+	uint32_t* dirty_list;
+	caulk_Range* ranges;
+	size_t num_dirty;
+	bool ranges_stale;
+
+	char* text;
+	size_t text_used, text_size, text_live;
+} Friends;
+
+static Friends friends = {};
+
+static size_t friend_bucket(uint64_t id) {
+	return (size_t)((id * UINT64_C(0x9E3779B97F4A7C15)) >> 32) & (friends.capacity * 2 - 1);
+}
+
+static void index_friend(size_t pos) {
+	size_t bucket = friend_bucket(friends.ids[pos]);
+	while (friends.index[bucket])
+		bucket = (bucket + 1) & (friends.capacity * 2 - 1);
+	friends.index[bucket] = (uint32_t)pos + 1;
+}
+
+static void index_friends() {
+	memset(friends.index, 0, friends.capacity * 2 * sizeof(uint32_t));
+	for (size_t pos = 0; pos < friends.view.count; pos++)
+		index_friend(pos);
+}
+
+static int64_t find_friend(uint64_t id) {
+	size_t mask = friends.capacity * 2 - 1;
+	for (size_t bucket = friend_bucket(id); friends.index[bucket]; bucket = (bucket + 1) & mask)
+		if (friends.ids[friends.index[bucket] - 1] == id)
+			return friends.index[bucket] - 1;
+	return -1;
+}
+
+static bool grow_friends() {
+	size_t old = friends.capacity, capacity = old ? old * 2 : 64;
+	if (!caulk_grow_array(&friends.ids, sizeof(uint64_t), old, capacity)
+		|| !caulk_grow_array(&friends.games, sizeof(uint64_t), old, capacity)
+		|| !caulk_grow_array(&friends.lobbies, sizeof(uint64_t), old, capacity)
+		|| !caulk_grow_array(&friends.names, sizeof(uint32_t), old, capacity)
+		|| !caulk_grow_array(&friends.persona_states, sizeof(int32_t), old, capacity)
+		|| !caulk_grow_array(&friends.dirty, sizeof(bool), old, capacity)
+		|| !caulk_grow_array(&friends.dirty_list, sizeof(uint32_t), old, capacity)
+		|| !caulk_grow_array(&friends.ranges, sizeof(caulk_Range), old, capacity))
+		return false;
+	memset(friends.dirty + old, 0, capacity - old);
+
+	uint32_t* index = (uint32_t*)caulk_config.alloc(capacity * 2 * sizeof(uint32_t), caulk_config.userdata);
+	if (!index)
+		return false;
+	if (friends.index)
+		caulk_config.dealloc(friends.index, caulk_config.userdata);
+	friends.index = index, friends.capacity = capacity;
+	index_friends();
+	return true;
+}
+
+// A position can be listed while past the end, after a removal, and count again once a friend's added there.
+static void mark_friend(size_t pos) {
+	friends.ranges_stale = true;
+	if (friends.dirty[pos])
+		return;
+	friends.dirty[pos] = true;
+	friends.dirty_list[friends.num_dirty++] = (uint32_t)pos;
+}
+
+// Rewrites `text` with only the names still in use, into a buffer with room for at least `extra` more bytes.
+static bool compact_names(size_t extra) {
+	size_t size = friends.text_size;
+	while (size < (friends.text_live + extra) * 2)
+		size *= 2;
+
+	char* text = (char*)caulk_config.alloc(size, caulk_config.userdata);
+	if (!text)
+		return false;
+
+	size_t used = 0;
+	for (size_t pos = 0; pos < friends.view.count; pos++) {
+		const char* name = friends.text + friends.names[pos];
+		size_t len = strlen(name) + 1;
+		memcpy(text + used, name, len);
+		friends.names[pos] = (uint32_t)used, used += len;
+		mark_friend(pos);
+	}
+
+	caulk_config.dealloc(friends.text, caulk_config.userdata);
+	friends.text = text, friends.text_used = used, friends.text_size = size;
+	return true;
+}
+
+static bool set_friend_name(size_t pos, const char* name, bool replacing) {
+	size_t len = strlen(name) + 1;
+	if (friends.text_used + len > friends.text_size) {
+		bool stale = friends.text_used - friends.text_live > friends.text_live;
+		if (stale ? !compact_names(len)
+				  : !caulk_grow_array(&friends.text, 1, friends.text_used, friends.text_size * 2 + len))
+			return false;
+		if (!stale)
+			friends.text_size = friends.text_size * 2 + len;
+	}
+
+	if (replacing)
+		friends.text_live -= strlen(friends.text + friends.names[pos]) + 1;
+	memcpy(friends.text + friends.text_used, name, len);
+	friends.names[pos] = (uint32_t)friends.text_used;
+	friends.text_used += len, friends.text_live += len;
+	return true;
+}
+
+// Reads one friend's fields from Steam again, and marks them dirty if anything's different. Only fails when there's no
+// memory for a new friend's name; a rename that doesn't fit keeps the old one.
+static bool refresh_friend(size_t pos, bool added) {
+	ISteamFriends* iface = caulk_gSteamFriends;
+	uint64_t id = friends.ids[pos];
+
+	const char* name = SteamAPI_ISteamFriends_GetFriendPersonaName(iface, id);
+	if (!name)
+		name = "";
+	bool changed = added || strcmp(friends.text + friends.names[pos], name);
+	if (changed && !set_friend_name(pos, name, !added) && added)
+		return false;
+
+	int32_t state = (int32_t)SteamAPI_ISteamFriends_GetFriendPersonaState(iface, id);
+	FriendGameInfo_t game;
+	uint64_t game_id = 0, lobby = 0;
+	if (SteamAPI_ISteamFriends_GetFriendGamePlayed(iface, id, &game))
+		game_id = game.m_gameID.ToUint64(), lobby = game.m_steamIDLobby.ConvertToUint64();
+
+	changed |= friends.persona_states[pos] != state || friends.games[pos] != game_id;
+	changed |= friends.lobbies[pos] != lobby;
+	friends.persona_states[pos] = state, friends.games[pos] = game_id, friends.lobbies[pos] = lobby;
+	if (changed)
+		mark_friend(pos);
+	return true;
+}
+
+static bool add_friend(uint64_t id) {
+	if (friends.view.count == friends.capacity && !grow_friends())
+		return false;
+
+	size_t pos = friends.view.count;
+	friends.ids[pos] = id;
+	if (!refresh_friend(pos, true))
+		return false;
+	friends.view.count++;
+	index_friend(pos);
+	return true;
+}
+
+// The last friend moves into the gap.
+static void remove_friend(size_t pos) {
+	friends.text_live -= strlen(friends.text + friends.names[pos]) + 1;
+
+	size_t last = --friends.view.count;
+	if (pos != last) {
+		friends.ids[pos] = friends.ids[last], friends.names[pos] = friends.names[last];
+		friends.persona_states[pos] = friends.persona_states[last];
+		friends.games[pos] = friends.games[last], friends.lobbies[pos] = friends.lobbies[last];
+	}
+	mark_friend(pos);
+	index_friends();
+}
+
+static void on_persona_state_change(void* data, void* ctx) {
+	(void)ctx;
+	const PersonaStateChange_t* change = reinterpret_cast<const PersonaStateChange_t*>(data);
+	int64_t pos = find_friend(change->m_ulSteamID);
+
+	// often comes along with a name, status or game change, which still needs picking up below
+	if (change->m_nChangeFlags & k_EPersonaChangeRelationshipChanged) {
+		bool is_friend = SteamAPI_ISteamFriends_HasFriend(
+			caulk_gSteamFriends, change->m_ulSteamID, caulk_config.friends_snapshot_flags);
+		if (pos < 0 && is_friend) {
+			add_friend(change->m_ulSteamID); // reads everything anyway
+			return;
+		}
+		if (pos >= 0 && !is_friend) {
+			remove_friend((size_t)pos);
+			return;
+		}
+	}
+
+	// everyone Steam tells us about, lobby members and the like, not just friends
+	if (pos >= 0)
+		refresh_friend((size_t)pos, false);
+}
+
+bool caulk_load_friends() {
+	friends.text_size = 4096;
+	friends.text = (char*)caulk_config.alloc(friends.text_size, caulk_config.userdata);
+	if (!friends.text || !grow_friends())
+		return false;
+
+	ISteamFriends* iface = caulk_gSteamFriends;
+	int flags = caulk_config.friends_snapshot_flags;
+	int count = SteamAPI_ISteamFriends_GetFriendCount(iface, flags);
+	for (int idx = 0; idx < count; idx++)
+		if (!add_friend(SteamAPI_ISteamFriends_GetFriendByIndex(iface, idx, flags)))
+			return false;
+
+	caulk_ClearFriendsSnapshotDirty();
+	return caulk_subscribe(PersonaStateChange_t_iCallback, on_persona_state_change, NULL) != 0;
+}
+
+void caulk_free_friends() {
+	void* arrays[] = {friends.ids, friends.games, friends.lobbies, friends.names, friends.persona_states,
+		friends.index, friends.dirty, friends.dirty_list, friends.ranges, friends.text};
+	for (size_t idx = 0; idx < LENGTH(arrays); idx++)
+		if (arrays[idx])
+			caulk_config.dealloc(arrays[idx], caulk_config.userdata);
+	friends = {};
+}
+
+static int compare_positions(const void* a, const void* b) {
+	uint32_t lhs = *(const uint32_t*)a, rhs = *(const uint32_t*)b;
+	return lhs < rhs ? -1 : lhs > rhs;
+}
+
+const caulk_FriendsSnapshot* caulk_GetFriendsSnapshot() {
+	if (!friends.text)
+		return NULL;
+
+	if (friends.ranges_stale) {
+		qsort(friends.dirty_list, friends.num_dirty, sizeof(uint32_t), compare_positions);
+
+		size_t num_ranges = 0;
+		for (size_t idx = 0; idx < friends.num_dirty; idx++) {
+			uint32_t pos = friends.dirty_list[idx];
+			if (pos >= friends.view.count)
+				break; // only ever left behind by a removal
+			caulk_Range* last = num_ranges ? &friends.ranges[num_ranges - 1] : NULL;
+			if (last && last->first + last->count == pos)
+				last->count++;
+			else
+				friends.ranges[num_ranges++] = {pos, 1};
+		}
+		friends.view.num_dirty = num_ranges, friends.ranges_stale = false;
+	}
+
+	friends.view.ids = friends.ids, friends.view.names = friends.names, friends.view.name_text = friends.text;
+	friends.view.persona_states = friends.persona_states;
+	friends.view.games = friends.games, friends.view.lobbies = friends.lobbies;
+	friends.view.dirty = friends.ranges;
+	return &friends.view;
+}
+
+void caulk_ClearFriendsSnapshotDirty() {
+	for (size_t idx = 0; idx < friends.num_dirty; idx++)
+		friends.dirty[friends.dirty_list[idx]] = false;
+	friends.num_dirty = 0, friends.view.num_dirty = 0, friends.ranges_stale = false;
+}
+}
@@ -23,7 +23,11 @@
 //
 // For more information, please refer to <https://unlicense.org>
 
+#include <ctype.h>
+#include <inttypes.h>
+#include <stdarg.h>
 #include <stdbool.h>
+#include <stdint.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
@@ -40,9 +44,133 @@
 
 #define LENGTH(expr) (sizeof((expr)) / sizeof(*(expr)))
 
-static void fprintN(FILE* file, const char* str, size_t len) {
-	for (size_t i = 0; i < len; i++)
-		fputc(str[i], file);
+// Everything is generated into memory first, and written out at the very end only where it differs from what's already
+// on disk. That way regenerating from the same SDK leaves every timestamp alone, and nothing including caulk.h
+// recompiles.
+typedef struct {
+	char path[1024];
+	char* data;
+	size_t size, capacity;
+} Output;
+
+static Output gOutputs[512] = {0};
+static size_t gNumOutputs = 0;
+
+static Output* openOutput(const char* path) {
+	if (gNumOutputs == LENGTH(gOutputs))
+		exit(EXIT_FAILURE);
+
+	Output* out = &gOutputs[gNumOutputs++];
+	snprintf(out->path, sizeof(out->path), "%s", path);
+	return out;
+}
+
+static void reserve(Output* out, size_t len) {
+	if (out->size + len + 1 <= out->capacity)
+		return;
+
+	size_t capacity = out->capacity ? out->capacity : 4096;
+	while (capacity < out->size + len + 1)
+		capacity *= 2;
+	if (!(out->data = realloc(out->data, capacity)))
+		exit(EXIT_FAILURE);
+	out->capacity = capacity;
+}
+
+static void emitN(Output* out, const char* str, size_t len) {
+	reserve(out, len);
+	memcpy(out->data + out->size, str, len);
+	out->size += len, out->data[out->size] = '\0';
+}
+
+static void emit(Output* out, const char* fmt, ...) {
+	va_list args;
+	va_start(args, fmt);
+	int len = vsnprintf(NULL, 0, fmt, args);
+	va_end(args);
+	if (len < 0)
+		exit(EXIT_FAILURE);
+
+	reserve(out, (size_t)len);
+	va_start(args, fmt);
+	vsnprintf(out->data + out->size, (size_t)len + 1, fmt, args);
+	va_end(args);
+	out->size += (size_t)len;
+}
+
+static bool sameAsOnDisk(const Output* out) {
+	FILE* file = fopen(out->path, "rb");
+	if (!file)
+		return false;
+
+	static char buf[4096] = {0};
+	size_t offset = 0, len = 0;
+	bool same = true;
+	while (same && (len = fread(buf, 1, sizeof(buf), file))) {
+		same = offset + len <= out->size && !memcmp(buf, out->data + offset, len);
+		offset += len;
+	}
+
+	fclose(file);
+	return same && offset == out->size;
+}
+
+static void writeOutputs() {
+	for (size_t i = 0; i < gNumOutputs; i++) {
+		const Output* out = &gOutputs[i];
+		if (sameAsOnDisk(out))
+			continue;
+
+		FILE* file = fopen(out->path, "wb");
+		if (!file || (out->size && fwrite(out->data, 1, out->size, file) != out->size))
+			exit(EXIT_FAILURE);
+		fclose(file);
+	}
+}
+
+// FNV-1a, over the generator's own binary, its arguments and `steam_api.json`. If the stamp left by the last run has
+// the same hash, there's nothing to do.
+#define HASH_SEED (14695981039346656037ull)
+
+static uint64_t hashBytes(uint64_t hash, const void* data, size_t size) {
+	for (size_t i = 0; i < size; i++)
+		hash = (hash ^ ((const uint8_t*)data)[i]) * 1099511628211ull;
+	return hash;
+}
+
+static bool hashFile(uint64_t* hash, const char* path) {
+	FILE* file = fopen(path, "rb");
+	if (!file)
+		return false;
+
+	static char buf[4096] = {0};
+	size_t len = 0;
+	while ((len = fread(buf, 1, sizeof(buf), file)))
+		*hash = hashBytes(*hash, buf, len);
+
+	fclose(file);
+	return true;
+}
+
+// The stamp is the hash on its first line, followed by every file written along with it.
+static bool upToDate(const char* stampName, uint64_t hash) {
+	FILE* stamp = fopen(stampName, "rb");
+	if (!stamp)
+		return false;
+
+	static char line[1024] = {0};
+	bool same = fgets(line, sizeof(line), stamp) && strtoull(line, NULL, 16) == hash;
+	while (same && fgets(line, sizeof(line), stamp)) {
+		line[strcspn(line, "\r\n")] = '\0';
+
+		FILE* file = fopen(line, "rb");
+		same = file != NULL;
+		if (file)
+			fclose(file);
+	}
+
+	fclose(stamp);
+	return same;
 }
 
 static const char* fileBasename(const char* path) {
@@ -52,9 +180,22 @@ static const char* fileBasename(const char* path) {
 	return s ? s + 1 : path;
 }
 
-static FILE* cppOutput = NULL;
-/// just the Steamworks method prototypes here.
-static FILE* apiOutput = NULL;
+/// the glue being written: `__gen.cpp`, or an interface's own `__gen_<Interface>.cpp` while that one is wrapped.
+static Output* cppOutput = NULL;
+static Output* glueOutput = NULL;
+/// output path of `__gen.cpp` minus the extension, which the other glue files are named after.
+static char gGlueStem[1024] = {0};
+/// just the Steamworks method prototypes here: `caulk/types.h`, or an interface's own header while that one is wrapped.
+static Output* apiOutput = NULL;
+static Output* typesOutput = NULL;
+/// what doesn't need any definitions: constants, forward declarations, typedefs and callback IDs (`caulk/base.h`).
+static Output* baseOutput = NULL;
+/// where the per-interface headers go (`<public dir>/caulk/`), and the ones written so far for the umbrella header.
+static char gHeaderDir[1024] = {0};
+static char gHeaders[256][64] = {0};
+static size_t gNumHeaders = 0;
+/// do-nothing definitions of the flat API for the mock Steam backend (optional).
+static Output* mockOutput = NULL;
 
 static yyjson_doc* gDoc = NULL;
 #define ROOT_OBJ (yyjson_doc_get_root(gDoc))
@@ -126,8 +267,34 @@ static bool isConstructor(yyjson_val* method) {
 	return strstr(yyjson_get_str(yyjson_obj_get(method, "methodname_flat")), "Construct") != NULL;
 }
 
+// Every enum and struct `caulk/types.h` defines, and where. Each definition has a guard of its own, so an interface
+// header can repeat just the ones it uses without clashing with `caulk/types.h` or another interface's header.
+static struct {
+	char name[128];
+	size_t start, end;
+	yyjson_val* struc; // the struct's fields, or `NULL` for an enum
+	bool used;
+} gDefinitions[2048] = {0};
+static size_t gNumDefinitions = 0;
+
+static void beginDefinition(const char* name, yyjson_val* struc) {
+	if (gNumDefinitions == LENGTH(gDefinitions))
+		exit(EXIT_FAILURE);
+
+	snprintf(gDefinitions[gNumDefinitions].name, sizeof(gDefinitions[0].name), "%s", name);
+	gDefinitions[gNumDefinitions].struc = struc, gDefinitions[gNumDefinitions].start = typesOutput->size;
+	emit(typesOutput, "#if !defined(CAULK_INTERNAL) && !defined(CAULK_DEFINED_%s)\n", name);
+	emit(typesOutput, "#define CAULK_DEFINED_%s\n", name);
+}
+
+static void endDefinition() {
+	emit(typesOutput, "#endif\n\n");
+	gDefinitions[gNumDefinitions++].end = typesOutput->size;
+}
+
 static void defineEnum(yyjson_val* enm, const char* master) {
-	fprintf(apiOutput, "typedef enum {\n");
+	beginDefinition(fieldName(yyjson_get_str(yyjson_obj_get(enm, "enumname")), master), NULL);
+	emit(typesOutput, "typedef enum {\n");
 
 	yyjson_val* val = NULL;
 	yyjson_val* values = yyjson_obj_get(enm, "values");
@@ -137,45 +304,112 @@ static void defineEnum(yyjson_val* enm, const char* master) {
 	while ((val = yyjson_arr_iter_next(&iter))) {
 		const char* name = yyjson_get_str(yyjson_obj_get(val, "name"));
 		const char* value = yyjson_get_str(yyjson_obj_get(val, "value"));
-		fprintf(apiOutput, INDENT "%s = %s,\n", name, value);
+		emit(typesOutput, INDENT "%s = %s,\n", name, value);
 	}
 
 	const char* name = fieldName(yyjson_get_str(yyjson_obj_get(enm, "enumname")), master);
-	fprintf(apiOutput, "} %s;\n\n", name);
+	emit(typesOutput, "} %s;\n", name);
+	endDefinition();
 }
 
 static void genEnums(yyjson_val* enums, const char* master) {
 	yyjson_arr_iter iter;
 	yyjson_arr_iter_init(enums, &iter);
 
-	if (yyjson_get_len(enums))
-		fprintf(apiOutput, "#ifndef CAULK_INTERNAL\n\n");
-
 	yyjson_val* enm = NULL;
 	while ((enm = yyjson_arr_iter_next(&iter)))
 		defineEnum(enm, master);
-
-	if (yyjson_get_len(enums))
-		fprintf(apiOutput, "#endif\n\n");
 }
 
-static void writeDecl(FILE* out, const char* name, const char* type, bool private) {
+static void writeDecl(Output* out, const char* name, const char* type, bool private) {
 	char* offset = strstr(type, "(*)");
 	if (offset) {
-		fprintN(out, type, offset + 2 - type);
-		fprintf(out, "%s%s%s", private ? "__" : "", name, offset + 2);
+		emitN(out, type, offset + 2 - type);
+		emit(out, "%s%s%s", private ? "__" : "", name, offset + 2);
 		return;
 	}
 
 	offset = strstr(type, "[");
 	if (offset) {
-		fprintN(out, type, offset - 1 - type);
-		fprintf(out, " %s%s%s", private ? "__" : "", name, offset);
+		emitN(out, type, offset - 1 - type);
+		emit(out, " %s%s%s", private ? "__" : "", name, offset);
 		return;
 	}
 
-	fprintf(out, "%s", type);
-	fprintf(out, " %s%s", private ? "__" : "", name);
+	emit(out, "%s", type);
+	emit(out, " %s%s", private ? "__" : "", name);
+}
+
+// `steam_api.json` doesn't say how the SDK packs its structs, so these follow its headers. Every struct is packed like
+// the callbacks (`VALVE_CALLBACK_PACK_SMALL` on the platforms `callbackPacking` names, `VALVE_CALLBACK_PACK_LARGE` on
+// the rest), except for the ones in `structPacking`, each listed with the header that packs it.
+typedef struct {
+	const char* condition; // `NULL` for everything else
+	int pack;
+} Packing;
+
+static const Packing callbackPacking[] = {
+	{"defined(__linux__) || defined(__APPLE__) || defined(__FreeBSD__)", 4},
+	{NULL,                                                               8},
+};
+
+typedef struct {
+	const char* name;
+	int pack;
+} StructPacking;
+
+static const StructPacking structPacking[] = {
+	{"InputAnalogActionData_t",       1}, // isteaminput.h
+	{"InputDigitalActionData_t",      1}, // isteaminput.h
+	{"InputMotionData_t",             1}, // isteaminput.h
+	{"ControllerAnalogActionData_t",  1}, // isteamcontroller.h
+	{"ControllerDigitalActionData_t", 1}, // isteamcontroller.h
+	{"ControllerMotionData_t",        1}, // isteamcontroller.h
+};
+
+// Returns the packing a struct gets instead of the callbacks', or 0 if none.
+static int structPack(const char* name) {
+	for (size_t i = 0; i < LENGTH(structPacking); i++)
+		if (!strcmp(name, structPacking[i].name))
+			return structPacking[i].pack;
+	return 0;
+}
+
+// The SDK packs its callbacks (and most other structs) to 4 bytes on Linux and macOS and to 8 elsewhere, which moves
+// 64-bit fields on Linux. caulk's mirrors follow suit.
+static void pushCallbackPacking(Output* out) {
+	for (size_t i = 0; i < LENGTH(callbackPacking); i++) {
+		const Packing* packing = &callbackPacking[i];
+		if (packing->condition)
+			emit(out, "#%s %s\n", i ? "elif" : "if", packing->condition);
+		else
+			emit(out, "#else\n");
+		emit(out, "#pragma pack(push, %d)\n", packing->pack);
+	}
+	emit(out, "#endif\n\n");
+}
+
+// The glue reinterprets caulk's structs as the SDK's and back, so every field has to sit where the SDK puts it. A
+// struct with private fields only gets its size checked, since `offsetof()` can't see into it.
+static void assertSameLayout(yyjson_val* struc) {
+	const char* name = structName(struc);
+	emit(glueOutput, "static_assert(sizeof(" NS_PREFIX "%s) == sizeof(::%s), ", name, name);
+	emit(glueOutput, "\"%s doesn't match the SDK\");\n", name);
+
+	yyjson_arr_iter iter;
+	yyjson_arr_iter_init(yyjson_obj_get(struc, "fields"), &iter);
+
+	yyjson_val* field = NULL;
+	while ((field = yyjson_arr_iter_next(&iter)))
+		if (yyjson_get_bool(yyjson_obj_get(field, "private")))
+			return;
+
+	yyjson_arr_iter_init(yyjson_obj_get(struc, "fields"), &iter);
+	while ((field = yyjson_arr_iter_next(&iter))) {
+		const char* fName = yyjson_get_str(yyjson_obj_get(field, "fieldname"));
+		emit(glueOutput, "static_assert(offsetof(" NS_PREFIX "%s, %s) == ", name, fName);
+		emit(glueOutput, "offsetof(::%s, %s), \"%s::%s doesn't match the SDK\");\n", name, fName, name, fName);
+	}
 }
 
 static void genFields(yyjson_val* struc) {
@@ -186,8 +420,11 @@ static void genFields(yyjson_val* struc) {
 	yyjson_arr_iter iter;
 	yyjson_arr_iter_init(fields, &iter);
 
-	fprintf(apiOutput, "#ifndef CAULK_INTERNAL\n");
-	fprintf(apiOutput, "struct %s {\n", structName(struc));
+	int pack = structPack(structName(struc));
+	beginDefinition(structName(struc), struc);
+	if (pack)
+		emit(typesOutput, "#pragma pack(push, %d)\n", pack);
+	emit(typesOutput, "struct %s {\n", structName(struc));
 
 	yyjson_val* field = NULL;
 	while ((field = yyjson_arr_iter_next(&iter))) {
@@ -195,16 +432,20 @@ static void genFields(yyjson_val* struc) {
 			   *type = yyjson_get_str(yyjson_obj_get(field, "fieldtype"));
 		bool private = yyjson_get_bool(yyjson_obj_get(field, "private"));
 
-		fprintf(apiOutput, INDENT);
-		writeDecl(apiOutput, name, sanitizeType(type), private);
-		fprintf(apiOutput, ";\n");
+		emit(typesOutput, INDENT);
+		writeDecl(typesOutput, name, sanitizeType(type), private);
+		emit(typesOutput, ";\n");
 	}
 
-	fprintf(apiOutput, "};\n");
-	fprintf(apiOutput, "#endif\n\n");
+	emit(typesOutput, "};\n");
+	if (pack)
+		emit(typesOutput, "#pragma pack(pop)\n");
+	endDefinition();
+
+	assertSameLayout(struc);
 }
 
-static void writeParams(FILE* out, yyjson_val* params) {
+static void writeParams(Output* out, yyjson_val* params) {
 	yyjson_arr_iter iter;
 	yyjson_arr_iter_init(params, &iter);
 
@@ -218,9 +459,9 @@ static void writeParams(FILE* out, yyjson_val* params) {
 		if (out == cppOutput)
 			snprintf(type, sizeof(type), "%s", prefixUserType(type));
 
-		fprintf(out, "%s %s", type, name);
+		emit(out, "%s %s", type, name);
 		if (yyjson_arr_iter_has_next(&iter))
-			fprintf(out, ", ");
+			emit(out, ", ");
 	}
 }
 
@@ -228,6 +469,13 @@ static const char* ignoreForMethods[]
 	= {"SetDualSenseTriggerEffect", "ISteamNetworkingSockets", "SteamDatagramHostedAddress", "ISteamGameServer",
 		"ISteamNetworkingFakeUDPPort", "ISteamHTML", "SteamGameServer_v", "SteamGameServerStats_v"};
 
+static bool isIgnored(const char* methodName) {
+	for (size_t i = 0; i < LENGTH(ignoreForMethods); i++)
+		if (strstr(methodName, ignoreForMethods[i]))
+			return true;
+	return false;
+}
+
 enum {
 	methStruct,
 	methInterface,
@@ -245,7 +493,7 @@ static const char* normalizeMethodName(yyjson_val* method) {
 	return buf;
 }
 
-static void writeMethodSignature(FILE* out, yyjson_val* tMaster, yyjson_val* method, int kind) {
+static void writeMethodSignature(Output* out, yyjson_val* tMaster, yyjson_val* method, int kind) {
 	const char* metName = normalizeMethodName(method);
 	static char deezType[1024] = {0}, deezPtr[1024] = {0}, retType[1024] = {0};
 
@@ -261,16 +509,282 @@ static void writeMethodSignature(FILE* out, yyjson_val* tMaster, yyjson_val* met
 	}
 	snprintf(deezPtr, sizeof(deezPtr), "%s*", deezType);
 
-	fprintf(out, "%s %s(", retType, metName);
+	emit(out, "%s %s(", retType, metName);
 	if (kind == methStruct)
 		writeDecl(out, THIS, deezPtr, false);
 
 	yyjson_val* params = yyjson_obj_get(method, "params");
 	if (kind == methStruct && yyjson_get_len(params))
-		fprintf(out, ", ");
+		emit(out, ", ");
 	writeParams(out, params);
 
-	fprintf(out, ")");
+	emit(out, ")");
+}
+
+static const char* flatType(yyjson_val* val, const char* field) {
+	static char buf[1024] = {0};
+	snprintf(buf, sizeof(buf), "%s_flat", field);
+
+	const char* type = yyjson_get_str(yyjson_obj_get(val, buf));
+	return type ? type : yyjson_get_str(yyjson_obj_get(val, field));
+}
+
+// Each stub can be replaced by a hand-written one: the mock defines `MOCKED_<flat name>` before including these.
+static void mockMethod(yyjson_val* master, yyjson_val* method) {
+	const char *name = yyjson_get_str(yyjson_obj_get(method, "methodname_flat")),
+		   *returnType = flatType(method, "returntype");
+
+	emit(mockOutput, "#ifndef MOCKED_%s\n", name);
+	emit(mockOutput, "S_API %s %s(%s* self", returnType, name, structName(master));
+
+	yyjson_arr_iter iter;
+	yyjson_arr_iter_init(yyjson_obj_get(method, "params"), &iter);
+
+	yyjson_val* arg = NULL;
+	while ((arg = yyjson_arr_iter_next(&iter))) {
+		const char* pName = yyjson_get_str(yyjson_obj_get(arg, "paramname"));
+		emit(mockOutput, ", ");
+		writeDecl(mockOutput, pName, flatType(arg, "paramtype"), false);
+	}
+	emit(mockOutput, ") {\n");
+
+	if (strstr(returnType, "char *") || strstr(returnType, "char*"))
+		emit(mockOutput, INDENT "return \"\";\n");
+	else if (strcmp(returnType, "void"))
+		emit(mockOutput, INDENT "return {};\n");
+
+	emit(mockOutput, "}\n");
+	emit(mockOutput, "#endif\n\n");
+}
+
+// Interface pointers are fetched once by `caulk_Init()` rather than through the SDK's accessor on every call. Each one
+// is defined in its interface's glue right before the first wrapper that uses it, and declared in the prelude.
+static const char* gInterfaces[256] = {0};
+static size_t gNumInterfaces = 0;
+
+static const char* interfaceVar(const char* masterName) {
+	static char buf[1024] = {0};
+	snprintf(buf, sizeof(buf), METHOD_PREFIX "g%s", masterName + 1);
+	return buf;
+}
+
+/// `--direct`: the header forwards straight to the flat API wherever that's provably the same call.
+static bool gDirect = false;
+
+static void declareInterface(const char* masterName) {
+	for (size_t i = 0; i < gNumInterfaces; i++)
+		if (!strcmp(gInterfaces[i], masterName))
+			return;
+	if (gNumInterfaces == LENGTH(gInterfaces))
+		exit(EXIT_FAILURE);
+
+	gInterfaces[gNumInterfaces++] = masterName;
+	emit(cppOutput, "%s* %s = NULL;\n\n", masterName, interfaceVar(masterName));
+
+	// direct forwarders read the pointer from the header
+	if (gDirect) {
+		emit(apiOutput, "#ifndef CAULK_INTERNAL\n");
+		emit(apiOutput, "CAULK_FLAT %s %s;\n", masterName, interfaceVar(masterName));
+		emit(apiOutput, "#endif\n");
+	}
+}
+
+// Strips `const` and any pointer or reference off a type.
+static const char* baseType(const char* type, bool* indirect) {
+	static char buf[1024] = {0};
+	if (!strncmp(type, "const ", strlen("const ")))
+		type += strlen("const ");
+	snprintf(buf, sizeof(buf), "%s", type);
+
+	*indirect = false;
+	for (size_t len = strlen(buf); len && strchr("*& ", buf[len - 1]); len--) {
+		*indirect |= buf[len - 1] != ' ';
+		buf[len - 1] = '\0';
+	}
+	return buf;
+}
+
+static bool isBuiltinType(const char* type) {
+	static const char* builtins[] = {"void", "bool", "char", "signed char", "unsigned char", "short",
+		"unsigned short", "int", "unsigned int", "long", "unsigned long", "long long", "unsigned long long",
+		"float", "double", "size_t"};
+	for (size_t i = 0; i < LENGTH(builtins); i++)
+		if (!strcmp(type, builtins[i]))
+			return true;
+	return false;
+}
+
+static yyjson_val* findByName(const char* array, const char* field, const char* name) {
+	yyjson_arr_iter iter;
+	yyjson_arr_iter_init(yyjson_obj_get(ROOT_OBJ, array), &iter);
+
+	yyjson_val* val = NULL;
+	while ((val = yyjson_arr_iter_next(&iter)))
+		if (!strcmp(yyjson_get_str(yyjson_obj_get(val, field)), name))
+			return val;
+	return NULL;
+}
+
+// Scalars, top-level enums, typedefs of those, and pointers to any of them mean exactly the same to a C caller and to
+// the flat API. Structs stay behind the thunk, whose glue checks their layout against the SDK's.
+static bool isScalarType(const char* type, int depth) {
+	static char base[1024] = {0};
+	bool indirect = false;
+	snprintf(base, sizeof(base), "%s", baseType(type, &indirect));
+
+	if (depth > 8)
+		return false;
+	if (strpbrk(base, "()[:"))
+		return depth && strstr(base, "(*)"); // function pointer typedefs are fine
+	if (isBuiltinType(base) || findByName("enums", "enumname", base))
+		return true;
+
+	yyjson_val* typeDef = findByName("typedefs", "typedef", base);
+	return typeDef && isScalarType(yyjson_get_str(yyjson_obj_get(typeDef, "type")), depth + 1);
+}
+
+// `CSteamID` and `CGameID` are plain integers on both sides, as long as they're passed by value.
+static bool isIdType(const char* type) {
+	return !strcmp(type, "CSteamID") || !strcmp(type, "CGameID");
+}
+
+static bool canForward(yyjson_val* method) {
+	const char* returnType = yyjson_get_str(yyjson_obj_get(method, "returntype"));
+	if (!isIdType(returnType) && !isScalarType(returnType, 0))
+		return false;
+
+	yyjson_arr_iter iter;
+	yyjson_arr_iter_init(yyjson_obj_get(method, "params"), &iter);
+
+	yyjson_val* arg = NULL;
+	while ((arg = yyjson_arr_iter_next(&iter))) {
+		const char* type = yyjson_get_str(yyjson_obj_get(arg, "paramtype"));
+		if (!isIdType(type) && !isScalarType(type, 0))
+			return false;
+	}
+	return true;
+}
+
+// The proof that forwarding is sound: every non-builtin type involved has the same size in C and in the SDK.
+static void assertSameType(yyjson_val* val, const char* field) {
+	static char seen[1024][128] = {0};
+	static size_t numSeen = 0;
+
+	static char caulkType[1024] = {0}, sdkType[1024] = {0};
+	bool indirect = false;
+	snprintf(caulkType, sizeof(caulkType), "%s", baseType(yyjson_get_str(yyjson_obj_get(val, field)), &indirect));
+	snprintf(sdkType, sizeof(sdkType), "%s", baseType(flatType(val, field), &indirect));
+	if (isBuiltinType(caulkType))
+		return;
+
+	for (size_t i = 0; i < numSeen; i++)
+		if (!strcmp(seen[i], caulkType))
+			return;
+	if (numSeen < LENGTH(seen))
+		snprintf(seen[numSeen++], sizeof(*seen), "%s", caulkType);
+
+	emit(cppOutput, "static_assert(sizeof(" NS_PREFIX "%s) == sizeof(::%s), \"%s doesn't match the SDK\");\n",
+		caulkType, sdkType, caulkType);
+}
+
+// Instead of a prototype, the header gets a `static inline` that calls the flat API itself. The glue still defines the
+// exported function, for anyone linking against it by name.
+static void forwardMethod(yyjson_val* master, yyjson_val* method) {
+	const char *masterName = structName(master),
+		   *methodNameFlat = yyjson_get_str(yyjson_obj_get(method, "methodname_flat")),
+		   *returnType = yyjson_get_str(yyjson_obj_get(method, "returntype"));
+	yyjson_val* params = yyjson_obj_get(method, "params");
+
+	emit(apiOutput, "#ifdef CAULK_INTERNAL\n");
+	writeMethodSignature(apiOutput, master, method, methInterface);
+	emit(apiOutput, ";\n");
+	emit(apiOutput, "#else\n");
+
+	emit(apiOutput, "CAULK_FLAT %s %s(%s self%s", returnType, methodNameFlat, masterName,
+		yyjson_get_len(params) ? ", " : "");
+	writeParams(apiOutput, params);
+	emit(apiOutput, ");\n");
+
+	emit(apiOutput, "static inline ");
+	writeMethodSignature(apiOutput, master, method, methInterface);
+	emit(apiOutput, " {\n" INDENT "%s%s(%s", strcmp(returnType, "void") ? "return " : "", methodNameFlat,
+		interfaceVar(masterName));
+
+	yyjson_arr_iter iter;
+	yyjson_arr_iter_init(params, &iter);
+
+	yyjson_val* arg = NULL;
+	while ((arg = yyjson_arr_iter_next(&iter)))
+		emit(apiOutput, ", %s", yyjson_get_str(yyjson_obj_get(arg, "paramname")));
+	emit(apiOutput, ");\n");
+
+	emit(apiOutput, "}\n");
+	emit(apiOutput, "#endif\n");
+
+	assertSameType(method, "returntype");
+	yyjson_arr_iter_init(params, &iter);
+	while ((arg = yyjson_arr_iter_next(&iter)))
+		assertSameType(arg, "paramtype");
+}
+
+static void genInterfaceLoader() {
+	emit(cppOutput, "void " METHOD_PREFIX "LoadInterfaces() {\n");
+	for (size_t i = 0; i < gNumInterfaces; i++)
+		emit(cppOutput, INDENT "%s = %s();\n", interfaceVar(gInterfaces[i]), gInterfaces[i] + 1);
+	emit(cppOutput, "}\n\n");
+
+	emit(cppOutput, "void " METHOD_PREFIX "UnloadInterfaces() {\n");
+	for (size_t i = 0; i < gNumInterfaces; i++)
+		emit(cppOutput, INDENT "%s = NULL;\n", interfaceVar(gInterfaces[i]));
+	emit(cppOutput, "}\n\n");
+}
+
+// Callback structs and their IDs, as `genCallbackId()` comes across them. Every callback ID gets a slot (numbered in ID
+// order), so the dispatcher can keep their handlers in a plain array. `key` and `flags` are what the callback can be
+// coalesced by, if anything.
+static struct {
+	const char* name;
+	int id, slot;
+	const char *key[2], *flags;
+} gCallbacks[1024] = {0};
+static size_t gNumCallbacks = 0;
+
+static bool isCallback(const char* name) {
+	for (size_t i = 0; i < gNumCallbacks; i++)
+		if (!strcmp(gCallbacks[i].name, name))
+			return true;
+	return false;
+}
+
+// `caulk_SteamMatchmaking_CreateLobby_Async(eLobbyType, cMaxMembers, handler, ctx)`: makes the call and resolves it in
+// one go, with a handler typed for the call result and only ever given that kind of result.
+static void asyncMethod(yyjson_val* method) {
+	const char *result = yyjson_get_str(yyjson_obj_get(method, "callresult")),
+		   *returnType = yyjson_get_str(yyjson_obj_get(method, "returntype"));
+	if (!result || strcmp(returnType, "SteamAPICall_t") || !isCallback(result))
+		return;
+
+	yyjson_val* params = yyjson_obj_get(method, "params");
+	emit(apiOutput, "#ifndef CAULK_INTERNAL\n");
+	emit(apiOutput, "static inline caulk_Handle %s_Async(", normalizeMethodName(method));
+	writeParams(apiOutput, params);
+	emit(apiOutput, "%svoid (*handler)(%s*, bool, void*), void* ctx) {\n", yyjson_get_len(params) ? ", " : "",
+		result);
+
+	emit(apiOutput, INDENT "SteamAPICall_t call = %s(", normalizeMethodName(method));
+	yyjson_arr_iter iter;
+	yyjson_arr_iter_init(params, &iter);
+
+	yyjson_val* arg = NULL;
+	while ((arg = yyjson_arr_iter_next(&iter)))
+		emit(apiOutput, "%s%s", yyjson_get_str(yyjson_obj_get(arg, "paramname")),
+			yyjson_arr_iter_has_next(&iter) ? ", " : "");
+	emit(apiOutput, ");\n");
+
+	emit(apiOutput, INDENT "return caulk_ResolveAs(call, %s_iCallback, (caulk_ResultHandlerCtx)handler, ctx);\n",
+		result);
+	emit(apiOutput, "}\n");
+	emit(apiOutput, "#endif\n");
 }
 
 static void wrapMethod(yyjson_val* master, yyjson_val* method, int kind) {
@@ -278,11 +792,20 @@ static void wrapMethod(yyjson_val* master, yyjson_val* method, int kind) {
 		   *methodNameFlat = yyjson_get_str(yyjson_obj_get(method, "methodname_flat")),
 		   *returnType = yyjson_get_str(yyjson_obj_get(method, "returntype"));
 
-	writeMethodSignature(apiOutput, master, method, kind);
-	fprintf(apiOutput, ";\n");
+	if (kind == methInterface)
+		declareInterface(masterName);
+
+	if (gDirect && kind == methInterface && canForward(method)) {
+		forwardMethod(master, method);
+	} else {
+		writeMethodSignature(apiOutput, master, method, kind);
+		emit(apiOutput, ";\n");
+	}
+	if (kind == methInterface)
+		asyncMethod(method);
 
 	writeMethodSignature(cppOutput, master, method, kind);
-	fprintf(cppOutput, " {\n");
+	emit(cppOutput, " {\n");
 
 	yyjson_val* params = yyjson_obj_get(method, "params");
 	if (isConstructor(method))
@@ -299,29 +822,27 @@ static void wrapMethod(yyjson_val* master, yyjson_val* method, int kind) {
 		static char pType[1024] = {0};
 		snprintf(pType, sizeof(pType), "%s", prefixUserType(sanitizeType(pType0)));
 
-		fprintf(cppOutput, INDENT "%s* __%s = &%s;\n", pType, pName, pName);
+		emit(cppOutput, INDENT "%s* __%s = &%s;\n", pType, pName, pName);
 	}
 
 	yyjson_arr_iter_init(params, &iter);
 	size_t count = yyjson_get_len(params), idx = 0;
 	int retVoid = !strcmp(returnType, "void");
 
-	fprintf(cppOutput, INDENT);
+	emit(cppOutput, INDENT);
 	if (!retVoid)
-		fprintf(cppOutput, "%s " RESULT " = ", returnType);
+		emit(cppOutput, "%s " RESULT " = ", returnType);
 
 	if (isConstructor(method)) {
-		fprintf(cppOutput, "%s(", returnType);
+		emit(cppOutput, "%s(", returnType);
 	} else if (kind == methInterface) {
-		static char ctor[512] = {0};
-		snprintf(ctor, sizeof(ctor), "%s", masterName + 1);
-		fprintf(cppOutput, "%s(\n" INDENT INDENT "%s()", methodNameFlat, ctor);
+		emit(cppOutput, "%s(\n" INDENT INDENT "%s", methodNameFlat, interfaceVar(masterName));
 	} else {
-		fprintf(cppOutput, "%s(\n" INDENT INDENT "reinterpret_cast<%s*>(" THIS ")", methodNameFlat, masterName);
+		emit(cppOutput, "%s(\n" INDENT INDENT "reinterpret_cast<%s*>(" THIS ")", methodNameFlat, masterName);
 	}
 
 	if (count)
-		fprintf(cppOutput, ",\n");
+		emit(cppOutput, ",\n");
 	while ((arg = yyjson_arr_iter_next(&iter))) {
 		const char *pName = yyjson_get_str(yyjson_obj_get(arg, "paramname")),
 			   *pType0 = yyjson_get_str(yyjson_obj_get(arg, "paramtype"));
@@ -329,28 +850,32 @@ static void wrapMethod(yyjson_val* master, yyjson_val* method, int kind) {
 		static char pType[1024] = {0};
 		snprintf(pType, sizeof(pType), "%s", sanitizeType(pType0));
 
-		fprintf(cppOutput, INDENT INDENT);
+		emit(cppOutput, INDENT INDENT);
 		for (size_t i = 0; i < strlen(pType0); i++)
 			if (pType0[i] == '&')
-				fprintf(cppOutput, "*");
+				emit(cppOutput, "*");
 			// HACK: `CSteamID` & `CGameID` are used as integers instead of the usual
 			// classes in `steam_api_flat.h`. So here we use them as-is instead of
 			// type-casting.
 			else if (!strcmp(pType, "CSteamID") || !strcmp(pType, "CGameID")) {
-				fprintf(cppOutput, "%s", pName);
+				emit(cppOutput, "%s", pName);
 				goto skip_reinterpret;
 			}
-		fprintf(cppOutput, "*reinterpret_cast<%s*>(__%s)", pType, pName);
+		emit(cppOutput, "*reinterpret_cast<%s*>(__%s)", pType, pName);
 	skip_reinterpret:
 		if (++idx < count)
-			fprintf(cppOutput, ",\n");
+			emit(cppOutput, ",\n");
 	}
-	fprintf(cppOutput, "\n" INDENT ");\n");
+	emit(cppOutput, "\n" INDENT ");\n");
 
 	if (!retVoid)
-		fprintf(cppOutput, INDENT "return *reinterpret_cast<%s*>(&" RESULT ");\n", prefixUserType(returnType));
+		emit(cppOutput, INDENT "return *reinterpret_cast<%s*>(&" RESULT ");\n", prefixUserType(returnType));
 
-	fprintf(cppOutput, "}\n\n");
+	emit(cppOutput, "}\n\n");
+
+	// constructors are wrapped with the C++ constructor itself, so there's no flat function to stub
+	if (mockOutput && !isConstructor(method))
+		mockMethod(master, method);
 }
 
 static void wrapStructMethod(yyjson_val* master, yyjson_val* method) {
@@ -374,25 +899,25 @@ static const char* normalizeAccessorName(yyjson_val* accessor) {
 	return buf;
 }
 
-static void writeAccessorSignature(FILE* out, yyjson_val* tMaster, yyjson_val* accessor) {
+static void writeAccessorSignature(Output* out, yyjson_val* tMaster, yyjson_val* accessor) {
 	static char deezType[1024] = {0};
 	if (out == cppOutput)
 		snprintf(deezType, sizeof(deezType), "%s", prefixUserType(structName(tMaster)));
 	else
 		snprintf(deezType, sizeof(deezType), "%s", structName(tMaster));
-	fprintf(out, "%s* %s()", deezType, normalizeAccessorName(accessor));
+	emit(out, "%s* %s()", deezType, normalizeAccessorName(accessor));
 }
 
 static void wrapAccessor(yyjson_val* tMaster, yyjson_val* acc) {
 	const char *mastName = structName(tMaster), *accName = yyjson_get_str(yyjson_obj_get(acc, "name"));
 	writeAccessorSignature(apiOutput, tMaster, acc);
-	fprintf(apiOutput, ";\n");
+	emit(apiOutput, ";\n");
 
 	writeAccessorSignature(cppOutput, tMaster, acc);
-	fprintf(cppOutput, " {\n");
-	fprintf(cppOutput, INDENT "%s* " RESULT " = %s();\n", mastName, accName);
-	fprintf(cppOutput, INDENT "return *reinterpret_cast<%s**>(&" RESULT ");\n", prefixUserType(mastName));
-	fprintf(cppOutput, "}\n\n");
+	emit(cppOutput, " {\n");
+	emit(cppOutput, INDENT "%s* " RESULT " = %s();\n", mastName, accName);
+	emit(cppOutput, INDENT "return *reinterpret_cast<%s**>(&" RESULT ");\n", prefixUserType(mastName));
+	emit(cppOutput, "}\n\n");
 }
 
 typedef struct {
@@ -422,20 +947,15 @@ static void genMethods(yyjson_val* master, bool isInterface) {
 		yyjson_val* methods = yyjson_obj_get(master, wrapper->arrayName);
 		if (!yyjson_get_len(methods))
 			continue;
-		fprintf(apiOutput, "\n");
+		emit(apiOutput, "\n");
 
 		yyjson_arr_iter iter;
 		yyjson_arr_iter_init(yyjson_obj_get(master, wrapper->arrayName), &iter);
 
 		yyjson_val* method = NULL;
 		while ((method = yyjson_arr_iter_next(&iter))) {
-			const char* name = yyjson_get_str(yyjson_obj_get(method, wrapper->flatnameField));
-			for (size_t i = 0; i < LENGTH(ignoreForMethods); i++)
-				if (strstr(name, ignoreForMethods[i]))
-					goto next;
-			wrapper->wrap(master, method);
-		next:
-			continue;
+			if (!isIgnored(yyjson_get_str(yyjson_obj_get(method, wrapper->flatnameField))))
+				wrapper->wrap(master, method);
 		}
 	}
 }
@@ -450,10 +970,10 @@ static void genConstants() {
 		const char *name = yyjson_get_str(yyjson_obj_get(cnst, "constname")),
 			   *type = yyjson_get_str(yyjson_obj_get(cnst, "consttype")),
 			   *value = yyjson_get_str(yyjson_obj_get(cnst, "constval"));
-		fprintf(apiOutput, "#define %s ((%s)(%s))\n", name, type, value);
+		emit(baseOutput, "#define %s ((%s)(%s))\n", name, type, value);
 	}
 
-	fprintf(apiOutput, "\n");
+	emit(baseOutput, "\n");
 }
 
 static void genTypedefs() {
@@ -463,7 +983,7 @@ static void genTypedefs() {
 	static const char* sources[] = {"structs", "callback_structs", [SPECIAL] = "interfaces"};
 	yyjson_arr_iter iter;
 
-	fprintf(apiOutput, "#ifndef CAULK_INTERNAL\n\n");
+	emit(baseOutput, "#ifndef CAULK_INTERNAL\n\n");
 
 	for (size_t i = 0; i < LENGTH(sources); i++) {
 		yyjson_arr_iter_init(yyjson_obj_get(ROOT_OBJ, sources[i]), &iter);
@@ -473,17 +993,17 @@ static void genTypedefs() {
 			const char* parent = yyjson_get_str(yyjson_obj_get(struc, "struct"));
 			if (i == SPECIAL) {
 				parent = yyjson_get_str(yyjson_obj_get(struc, "classname"));
-				fprintf(apiOutput, "typedef void* %s;\n", parent);
+				emit(baseOutput, "typedef void* %s;\n", parent);
 			} else {
-				fprintf(apiOutput, "struct %s;\n", parent);
-				fprintf(apiOutput, "#ifndef __cplusplus\n");
-				fprintf(apiOutput, "typedef struct %s %s;\n", parent, parent);
-				fprintf(apiOutput, "#endif\n");
+				emit(baseOutput, "struct %s;\n", parent);
+				emit(baseOutput, "#ifndef __cplusplus\n");
+				emit(baseOutput, "typedef struct %s %s;\n", parent, parent);
+				emit(baseOutput, "#endif\n");
 			}
 			genEnums(yyjson_obj_get(struc, "enums"), parent);
 		}
 
-		fprintf(apiOutput, "\n");
+		emit(baseOutput, "\n");
 	}
 #undef SPECIAL
 
@@ -494,21 +1014,294 @@ static void genTypedefs() {
 	while ((typeDef = yyjson_arr_iter_next(&iter))) {
 		const char *name = yyjson_get_str(yyjson_obj_get(typeDef, "typedef")),
 			   *type = yyjson_get_str(yyjson_obj_get(typeDef, "type"));
-		fprintf(apiOutput, "typedef ");
-		writeDecl(apiOutput, name, type, false);
-		fprintf(apiOutput, ";\n");
+		emit(baseOutput, "typedef ");
+		writeDecl(baseOutput, name, type, false);
+		emit(baseOutput, ";\n");
 	}
 
-	fprintf(apiOutput, "\n#endif\n\n");
+	emit(baseOutput, "\n#endif\n\n");
+}
+
+static bool isSteamIdField(const char* name, const char* type) {
+	if (strcmp(type, "CSteamID") && strcmp(type, "uint64") && strcmp(type, "uint64_steamid"))
+		return false;
+	for (; *name; name++)
+		if (!strncmp(name, "SteamID", strlen("SteamID")) || !strncmp(name, "steamID", strlen("steamID")))
+			return true;
+	return false;
+}
+
+// A callback about one or two entities (a friend, a lobby and one of its members) can be coalesced by their SteamIDs.
+// Bitmask fields named `...Flags` get ORed together when it is.
+static void findCoalesceKey(yyjson_val* struc, size_t idx) {
+	yyjson_arr_iter iter;
+	yyjson_arr_iter_init(yyjson_obj_get(struc, "fields"), &iter);
+
+	size_t numKeys = 0;
+	const char *key[3] = {0}, *flags = NULL;
+	yyjson_val* field = NULL;
+	while ((field = yyjson_arr_iter_next(&iter))) {
+		const char *name = yyjson_get_str(yyjson_obj_get(field, "fieldname")),
+			   *type = yyjson_get_str(yyjson_obj_get(field, "fieldtype"));
+		if (yyjson_get_bool(yyjson_obj_get(field, "private")))
+			continue;
+
+		size_t len = strlen(name);
+		bool bitmask = !strcmp(type, "int") || !strcmp(type, "uint32");
+		if (isSteamIdField(name, type) && numKeys < LENGTH(key))
+			key[numKeys++] = name;
+		else if (bitmask && len > strlen("Flags") && !strcmp(name + len - strlen("Flags"), "Flags"))
+			flags = name;
+	}
+
+	if (!numKeys || numKeys > 2)
+		return;
+	gCallbacks[idx].key[0] = key[0], gCallbacks[idx].key[1] = key[1], gCallbacks[idx].flags = flags;
 }
 
 static void genCallbackId(yyjson_val* struc) {
 	int id = yyjson_get_int(yyjson_obj_get(struc, "callback_id"));
-	if (id)
-		fprintf(apiOutput, "#define %s_iCallback %d\n", structName(struc), id);
+	if (!id)
+		return;
+
+	emit(baseOutput, "#define %s_iCallback %d\n", structName(struc), id);
+	if (gNumCallbacks == LENGTH(gCallbacks))
+		exit(EXIT_FAILURE);
+
+	gCallbacks[gNumCallbacks].name = structName(struc), gCallbacks[gNumCallbacks].id = id;
+	gCallbacks[gNumCallbacks].slot = -1;
+	findCoalesceKey(struc, gNumCallbacks++);
+}
+
+// What to coalesce every slotted callback by, as offsets into the SDK's own struct since that's what Steam hands over.
+// Only caulk itself sees these, and it has the SDK's structs where everyone else has caulk's.
+static void genCoalesceRules() {
+	emit(apiOutput, "typedef struct {\n");
+	emit(apiOutput, INDENT "int16_t key[2], flags; // offsets, -1 for none\n");
+	emit(apiOutput, "} caulk_CoalesceRule;\n\n");
+
+	emit(apiOutput, "static const caulk_CoalesceRule caulk_coalesce_rules[CAULK_CALLBACK_SLOTS] = {\n");
+	for (int slot = 0;; slot++) {
+		size_t i = 0;
+		while (i < gNumCallbacks && gCallbacks[i].slot != slot)
+			i++;
+		if (i == gNumCallbacks) {
+			if (!slot)
+				emit(apiOutput, INDENT "{{-1, -1}, -1},\n");
+			break;
+		}
+
+		const char* name = gCallbacks[i].name;
+		emit(apiOutput, INDENT "{{");
+		for (int k = 0; k < 2; k++) {
+			emit(apiOutput, "%s", k ? ", " : "");
+			if (gCallbacks[i].key[k])
+				emit(apiOutput, "(int16_t)offsetof(%s, %s)", name, gCallbacks[i].key[k]);
+			else
+				emit(apiOutput, "-1");
+		}
+		if (gCallbacks[i].flags)
+			emit(apiOutput, "}, (int16_t)offsetof(%s, %s)},\n", name, gCallbacks[i].flags);
+		else
+			emit(apiOutput, "}, -1},\n");
+	}
+	emit(apiOutput, "};\n\n");
+}
+
+// Only the dispatcher needs to know which slot a callback ID goes in. Callback IDs are small (a few thousand at most,
+// grouped by interface), so that's a lookup in an array covering all of them. Anything past `MAX_SLOTTED_RANGE` IDs
+// from the first one doesn't get a slot and is handled like an ID the SDK doesn't know about.
+#define MAX_SLOTTED_RANGE (8192)
+
+static void genCallbackSlots() {
+	int first = 0, last = -1;
+	for (size_t i = 0; i < gNumCallbacks; i++) {
+		int id = gCallbacks[i].id;
+		first = !i || id < first ? id : first, last = !i || id > last ? id : last;
+	}
+	if (last - first >= MAX_SLOTTED_RANGE)
+		last = first + MAX_SLOTTED_RANGE - 1;
+
+	emit(apiOutput, "#ifdef CAULK_INTERNAL\n");
+	emit(apiOutput, "#define CAULK_FIRST_CALLBACK %d\n\n", first);
+
+	int slots = 0;
+	emit(apiOutput, "static const int16_t caulk_callback_slots[] = {");
+	for (int id = first; id <= last; id++) {
+		int slot = -1;
+		for (size_t i = 0; i < gNumCallbacks && slot < 0; i++)
+			if (gCallbacks[i].id == id)
+				slot = gCallbacks[i].slot = slots++;
+		emit(apiOutput, "%s%d,", (id - first) % 16 ? " " : "\n" INDENT, slot);
+	}
+	emit(apiOutput, "%s};\n", last < first ? "-1" : "\n");
+	emit(apiOutput, "#define CAULK_CALLBACK_SLOTS %d\n\n", slots ? slots : 1);
+
+	emit(apiOutput, "static inline int32_t caulk_CallbackSlot(int32_t callback) {\n");
+	emit(apiOutput, INDENT "uint32_t idx = (uint32_t)callback - (uint32_t)CAULK_FIRST_CALLBACK;\n");
+	emit(apiOutput, INDENT "return idx < sizeof(caulk_callback_slots) / sizeof(*caulk_callback_slots) ? "
+			"caulk_callback_slots[idx] : -1;\n");
+	emit(apiOutput, "}\n\n");
+
+	genCoalesceRules();
+	emit(apiOutput, "#endif\n\n");
+}
+
+// `caulk_OnLobbyEnter(handler, ctx)` and so on: `caulk_RegisterCtx()` with the right ID and payload type.
+static void genTypedRegistration(Output* out) {
+	emit(out, "#ifndef CAULK_INTERNAL\n");
+	for (size_t i = 0; i < gNumCallbacks; i++) {
+		const char* name = gCallbacks[i].name;
+		size_t len = strlen(name);
+		if (len > 2 && !strcmp(name + len - 2, "_t"))
+			len -= 2;
+
+		emit(out, "static inline caulk_Handle caulk_On%.*s(void (*handler)(%s*, void*), void* ctx) {\n",
+			(int)len, name, name);
+		emit(out, INDENT "return caulk_RegisterCtx(%s_iCallback, (caulk_CallbackHandlerCtx)handler, ctx);\n",
+			name);
+		emit(out, "}\n");
+	}
+	emit(out, "#endif\n\n");
+}
+
+static const char* gluePath(const char* suffix) {
+	static char buf[1024] = {0};
+	snprintf(buf, sizeof(buf), "%s%s", gGlueStem, suffix);
+	return buf;
+}
+
+// `ISteamFriends` -> `friends.h`
+static const char* interfaceHeader(yyjson_val* iface) {
+	const char* name = structName(iface) + 1;
+	if (!strncmp(name, "Steam", strlen("Steam")))
+		name += strlen("Steam");
+
+	static char buf[64] = {0};
+	size_t i = 0;
+	for (; name[i] && i < sizeof(buf) - strlen(".h") - 1; i++)
+		buf[i] = (char)tolower((unsigned char)name[i]);
+	snprintf(buf + i, sizeof(buf) - i, ".h");
+	return buf;
+}
+
+// Marks every enum and struct a type names (through typedefs too), and whatever those structs' fields need in turn.
+static void useType(const char* type) {
+	char buf[1024] = {0};
+	snprintf(buf, sizeof(buf), "%s", sanitizeType(type));
+
+	for (char* s = buf; *s;) {
+		if (!isalpha((unsigned char)*s) && *s != '_') {
+			s++;
+			continue;
+		}
+
+		char* end = s;
+		while (isalnum((unsigned char)*end) || *end == '_')
+			end++;
+		char last = *end;
+		*end = '\0';
+
+		for (size_t i = 0; i < gNumDefinitions; i++) {
+			if (strcmp(gDefinitions[i].name, s) || gDefinitions[i].used)
+				continue;
+			gDefinitions[i].used = true;
+
+			yyjson_arr_iter iter;
+			yyjson_arr_iter_init(yyjson_obj_get(gDefinitions[i].struc, "fields"), &iter);
+
+			yyjson_val* field = NULL;
+			while ((field = yyjson_arr_iter_next(&iter)))
+				useType(yyjson_get_str(yyjson_obj_get(field, "fieldtype")));
+		}
+
+		yyjson_val* typeDef = findByName("typedefs", "typedef", s);
+		if (typeDef)
+			useType(yyjson_get_str(yyjson_obj_get(typeDef, "type")));
+
+		*end = last, s = end;
+	}
+}
+
+// An interface's header only repeats the definitions its own methods and call results use, in the order
+// `caulk/types.h` has them.
+static void genUsedDefinitions(yyjson_val* iface) {
+	for (size_t i = 0; i < gNumDefinitions; i++)
+		gDefinitions[i].used = false;
+
+	yyjson_arr_iter iter;
+	yyjson_arr_iter_init(yyjson_obj_get(iface, "methods"), &iter);
+
+	yyjson_val* method = NULL;
+	while ((method = yyjson_arr_iter_next(&iter))) {
+		if (isIgnored(yyjson_get_str(yyjson_obj_get(method, "methodname_flat"))))
+			continue;
+
+		useType(yyjson_get_str(yyjson_obj_get(method, "returntype")));
+		const char* result = yyjson_get_str(yyjson_obj_get(method, "callresult"));
+		if (result)
+			useType(result);
+
+		yyjson_arr_iter pIter;
+		yyjson_arr_iter_init(yyjson_obj_get(method, "params"), &pIter);
+
+		yyjson_val* arg = NULL;
+		while ((arg = yyjson_arr_iter_next(&pIter)))
+			useType(yyjson_get_str(yyjson_obj_get(arg, "paramtype")));
+	}
+
+	size_t numUsed = 0;
+	for (size_t i = 0; i < gNumDefinitions; i++)
+		numUsed += gDefinitions[i].used;
+	if (!numUsed)
+		return;
+
+	pushCallbackPacking(apiOutput);
+	for (size_t i = 0; i < gNumDefinitions; i++) {
+		size_t start = gDefinitions[i].start, end = gDefinitions[i].end;
+		if (gDefinitions[i].used)
+			emitN(apiOutput, typesOutput->data + start, end - start);
+	}
+	emit(apiOutput, "#pragma pack(pop)\n\n");
+}
+
+// Every interface gets a translation unit of its own so the glue compiles in parallel, and a header of its own so C
+// code can include only what it calls. Both are written even if all of its methods end up ignored, since the build
+// system expects them for every entry in `interfaces`.
+static void beginInterface(yyjson_val* iface) {
+	static char path[1024] = {0};
+	snprintf(path, sizeof(path), "_%s.cpp", structName(iface) + 1);
+	cppOutput = openOutput(gluePath(path));
+
+	emit(cppOutput, "#include \"%s\"\n\n", fileBasename(gluePath(".h")));
+	emit(cppOutput, "extern \"C\" {\n\n");
+
+	if (gNumHeaders == LENGTH(gHeaders))
+		exit(EXIT_FAILURE);
+	snprintf(gHeaders[gNumHeaders], sizeof(gHeaders[0]), "%s", interfaceHeader(iface));
+	snprintf(path, sizeof(path), "%s%s", gHeaderDir, gHeaders[gNumHeaders++]);
+	apiOutput = openOutput(path);
+
+	emit(apiOutput, "#pragma once\n\n");
+	emit(apiOutput, "#include \"core.h\"\n\n");
+	genUsedDefinitions(iface);
+
+	emit(apiOutput, "#ifdef __cplusplus\n");
+	emit(apiOutput, "extern \"C\" {\n");
+	emit(apiOutput, "#endif\n");
+}
+
+static void endInterface() {
+	emit(apiOutput, "\n#ifdef __cplusplus\n");
+	emit(apiOutput, "}\n");
+	emit(apiOutput, "#endif\n");
+	emit(cppOutput, "}\n");
+	cppOutput = glueOutput, apiOutput = typesOutput;
 }
 
 static void genStructs() {
+	pushCallbackPacking(typesOutput);
+
 #define SPECIAL (2)
 	static const char* sources[] = {"structs", "callback_structs", [SPECIAL] = "interfaces"};
 	for (size_t i = 0; i < LENGTH(sources); i++) {
@@ -516,92 +1309,443 @@ static void genStructs() {
 		yyjson_arr_iter_init(yyjson_obj_get(ROOT_OBJ, sources[i]), &iter);
 
 		yyjson_val* struc = NULL;
-		while ((struc = yyjson_arr_iter_next(&iter)))
+		while ((struc = yyjson_arr_iter_next(&iter))) {
+			if (i == SPECIAL)
+				beginInterface(struc);
 			genFields(struc), genMethods(struc, i == SPECIAL), genCallbackId(struc);
+			if (i == SPECIAL)
+				endInterface();
+		}
 	}
 #undef SPECIAL
-}
 
-int main(int argc, char* argv[]) {
-	if (argc != 5)
-		return EXIT_FAILURE;
+	emit(typesOutput, "#pragma pack(pop)\n\n");
+}
 
-	const char *hName = argv[1], *cppName = argv[2], *apiName = argv[3], *jsonName = argv[4];
+// What every glue file includes first: the SDK, caulk's declarations in their own namespace, and the interface
+// pointers shared with the loader.
+static void genGluePrelude(const char* apiName) {
+	Output* out = openOutput(gluePath(".h"));
 
-	apiOutput = fopen(apiName, "wt+"), cppOutput = fopen(cppName, "wt");
-	FILE* hOutput = fopen(hName, "wt");
+	emit(out, "#pragma once\n\n");
 
-	if (!apiOutput || !hOutput || !cppOutput)
-		return EXIT_FAILURE;
+	emit(out, "#include <cstddef>\n");
+	emit(out, "#include <steam_api_flat.h>\n\n");
 
-	yyjson_read_flag flg = YYJSON_READ_ALLOW_COMMENTS | YYJSON_READ_ALLOW_TRAILING_COMMAS;
-	yyjson_read_err err = {0};
-	gDoc = yyjson_read_file(jsonName, flg, NULL, &err);
+	emit(out, "namespace " NAMESPACE " {\n");
+	emit(out, "#include \"%s\"\n", fileBasename(apiName));
+	emit(out, "}\n\n");
 
-	if (!gDoc)
-		return EXIT_FAILURE;
+	emit(out, "extern \"C\" {\n");
+	for (size_t i = 0; i < gNumInterfaces; i++)
+		emit(out, "extern %s* %s;\n", gInterfaces[i], interfaceVar(gInterfaces[i]));
+	emit(out, "}\n");
+}
 
-	fprintf(hOutput, "#pragma once\n\n");
+static bool hasFields(const char* name) {
+	static const char* sources[] = {"structs", "callback_structs"};
+	for (size_t i = 0; i < LENGTH(sources); i++) {
+		yyjson_arr_iter iter;
+		yyjson_arr_iter_init(yyjson_obj_get(ROOT_OBJ, sources[i]), &iter);
 
-	fprintf(hOutput, "#include <stddef.h>\n");
-	fprintf(hOutput, "#include <stdint.h>\n");
-	fprintf(hOutput, "#include <stdbool.h>\n");
-	fprintf(hOutput, "#include <stdlib.h>\n");
+		yyjson_val* struc = NULL;
+		while ((struc = yyjson_arr_iter_next(&iter)))
+			if (!strcmp(structName(struc), name))
+				return yyjson_get_len(yyjson_obj_get(struc, "fields")) != 0;
+	}
+	return false;
+}
 
-	fprintf(apiOutput, "#include <inttypes.h>\n\n");
+// A union big enough for any struct that `steam_api.json` lists as a `callresult`, so the dispatcher can size its
+// result buffer once instead of allocating per completed call.
+static void genCallResultBuffer() {
+	static const char* seen[1024] = {0};
+	size_t numSeen = 0;
 
-	fprintf(apiOutput, "#define PRI_SteamID PRIu64\n");
-	fprintf(apiOutput, "#define PRI_CSteamID PRI_SteamID\n\n");
+	emit(apiOutput, "typedef union {\n");
+	emit(apiOutput, INDENT "uint64_t __align;\n");
 
-	fprintf(apiOutput, "#ifdef __cplusplus\n");
-	fprintf(apiOutput, "extern \"C\" {\n");
-	fprintf(apiOutput, "#endif\n\n");
+	static const char* sources[] = {"structs", "interfaces"};
+	for (size_t i = 0; i < LENGTH(sources); i++) {
+		yyjson_arr_iter iter;
+		yyjson_arr_iter_init(yyjson_obj_get(ROOT_OBJ, sources[i]), &iter);
 
-	fprintf(apiOutput, "#ifndef CAULK_INTERNAL\n");
-	fprintf(apiOutput, "typedef int32_t SteamInputActionEvent_t__AnalogAction_t;\n"); // :(
-	fprintf(apiOutput, "typedef uint64_t CSteamID, CGameID;\n");
-	fprintf(apiOutput, "typedef void (*SteamAPIWarningMessageHook_t)(int, const char*);\n");
-	fprintf(apiOutput, "#endif\n\n");
+		yyjson_val* master = NULL;
+		while ((master = yyjson_arr_iter_next(&iter))) {
+			yyjson_arr_iter mIter;
+			yyjson_arr_iter_init(yyjson_obj_get(master, "methods"), &mIter);
+
+			yyjson_val* method = NULL;
+			while ((method = yyjson_arr_iter_next(&mIter))) {
+				const char* result = yyjson_get_str(yyjson_obj_get(method, "callresult"));
+				if (!result || !hasFields(result)) // incomplete in the C header
+					continue;
+
+				for (size_t j = 0; j < numSeen; j++)
+					if (!strcmp(seen[j], result))
+						goto next;
+				if (numSeen < LENGTH(seen))
+					seen[numSeen++] = result;
+
+				emit(apiOutput, INDENT "char __%s[sizeof(%s)];\n", result, result);
+			next:
+				continue;
+			}
+		}
+	}
 
-	fprintf(apiOutput, "#ifdef __cplusplus\n");
-	fprintf(apiOutput, "}\n");
-	fprintf(apiOutput, "#endif\n\n");
+	emit(apiOutput, "} caulk_CallResultBuffer;\n\n");
+}
 
-	fprintf(cppOutput, "#include <steam_api_flat.h>\n\n");
+// The rest of caulk's own API, past making calls and taking callbacks, has a header per subsystem in `caulk/core/`.
+// Each one includes only what its own declarations use: the standard headers, or `caulk/base.h` for the Steam types.
+static char gCoreHeaders[16][64] = {0};
+static size_t gNumCoreHeaders = 0;
 
-	fprintf(cppOutput, "namespace " NAMESPACE " {\n");
-	fprintf(cppOutput, "#include \"%s\"\n", fileBasename(apiName));
-	fprintf(cppOutput, "}\n\n");
+static Output* beginCoreHeader(const char* name, bool steamTypes) {
+	if (gNumCoreHeaders == LENGTH(gCoreHeaders))
+		exit(EXIT_FAILURE);
+	snprintf(gCoreHeaders[gNumCoreHeaders++], sizeof(gCoreHeaders[0]), "%s", name);
 
-	fprintf(cppOutput, "extern \"C\" {\n\n");
-	genConstants(), genTypedefs(), genStructs();
-	fprintf(cppOutput, "}\n");
+	static char path[1024] = {0};
+	snprintf(path, sizeof(path), "%score/%s", gHeaderDir, name);
+	Output* out = openOutput(path);
 
-	fseek(apiOutput, 0, SEEK_SET);
-	while (!feof(apiOutput)) {
-		static char buf[1024] = {0};
-		fwrite(buf, 1, fread(buf, 1, sizeof(buf), apiOutput), hOutput);
+	emit(out, "#pragma once\n\n");
+	if (steamTypes) {
+		emit(out, "#include \"../base.h\"\n\n");
+	} else {
+		emit(out, "#include <stddef.h>\n");
+		emit(out, "#include <stdint.h>\n");
+		emit(out, "#include <stdbool.h>\n\n");
 	}
 
-	fprintf(hOutput, "#ifdef __cplusplus\n");
-	fprintf(hOutput, "extern \"C\" {\n");
-	fprintf(hOutput, "#endif\n\n");
+	emit(out, "#ifdef __cplusplus\n");
+	emit(out, "extern \"C\" {\n");
+	emit(out, "#endif\n\n");
+	return out;
+}
+
+static void endCoreHeader(Output* out) {
+	emit(out, "\n#ifdef __cplusplus\n");
+	emit(out, "}\n");
+	emit(out, "#endif\n");
+}
+
+static void genCoreHeaders() {
+	Output* out = beginCoreHeader("events.h", true);
+	emit(out, "typedef struct {\n");
+	emit(out, INDENT "SteamAPICall_t call;\n");
+	emit(out, INDENT "void* data;\n");
+	emit(out, INDENT "uint32_t callback, size;\n");
+	emit(out, INDENT "bool io_failed;\n");
+	emit(out, "} caulk_Event;\n\n");
+
+	emit(out, "size_t caulk_DispatchInto(caulk_Event* out, size_t cap, void* arena, size_t arena_size);\n");
+	endCoreHeader(out);
+
+	out = beginCoreHeader("poll.h", true);
+	emit(out, "typedef enum {\n");
+	emit(out, INDENT "caulk_PollPending,\n");
+	emit(out, INDENT "caulk_PollReady,\n");
+	emit(out, INDENT "caulk_PollFailed,\n");
+	emit(out, INDENT "caulk_PollEvicted,\n");
+	emit(out, "} caulk_PollStatus;\n\n");
+
+	emit(out, "caulk_PollStatus caulk_Poll(SteamAPICall_t, void* out, size_t size, bool* io_failed);\n");
+	endCoreHeader(out);
+
+	out = beginCoreHeader("friends.h", false);
+	emit(out, "typedef struct {\n");
+	emit(out, INDENT "uint32_t first, count;\n");
+	emit(out, "} caulk_Range;\n\n");
+
+	emit(out, "typedef struct {\n");
+	emit(out, INDENT "size_t count;\n");
+	emit(out, INDENT "const uint64_t* ids;\n");
+	emit(out, INDENT "const uint32_t* names; // offsets into `name_text`\n");
+	emit(out, INDENT "const char* name_text;\n");
+	emit(out, INDENT "const int32_t* persona_states;\n");
+	emit(out, INDENT "const uint64_t *games, *lobbies;\n");
+	emit(out, INDENT "const caulk_Range* dirty;\n");
+	emit(out, INDENT "size_t num_dirty;\n");
+	emit(out, "} caulk_FriendsSnapshot;\n\n");
+
+	emit(out, "const caulk_FriendsSnapshot* caulk_GetFriendsSnapshot();\n");
+	emit(out, "void caulk_ClearFriendsSnapshotDirty();\n");
+	endCoreHeader(out);
+
+	out = beginCoreHeader("stats.h", false);
+	emit(out, "typedef uint32_t caulk_Stat;\n\n");
+
+	emit(out, "typedef enum {\n");
+	emit(out, INDENT "caulk_StatInt32,\n");
+	emit(out, INDENT "caulk_StatFloat,\n");
+	emit(out, INDENT "caulk_StatAchievement,\n");
+	emit(out, "} caulk_StatKind;\n\n");
+
+	emit(out, "caulk_Stat caulk_RegisterStat(const char* name, caulk_StatKind);\n");
+	emit(out, "bool caulk_SetStatInt32(caulk_Stat, int32_t);\n");
+	emit(out, "bool caulk_SetStatFloat(caulk_Stat, float);\n");
+	emit(out, "bool caulk_SetAchievement(caulk_Stat);\n");
+	emit(out, "int32_t caulk_GetStatInt32(caulk_Stat);\n");
+	emit(out, "float caulk_GetStatFloat(caulk_Stat);\n");
+	emit(out, "bool caulk_GetAchievement(caulk_Stat);\n");
+	emit(out, "void caulk_StoreStats();\n");
+	endCoreHeader(out);
+
+	out = beginCoreHeader("lobbies.h", false);
+	emit(out, "#define CAULK_LOBBY_MEMBER_KEYS 8\n\n");
+
+	emit(out, "typedef struct {\n");
+	emit(out, INDENT "uint32_t key, value; // offsets into `text`\n");
+	emit(out, "} caulk_LobbyPair;\n\n");
+
+	emit(out, "typedef struct {\n");
+	emit(out, INDENT "uint64_t id;\n");
+	emit(out, INDENT "uint32_t first_pair, num_pairs;\n");
+	emit(out, INDENT "uint32_t first_member, num_members;\n");
+	emit(out, "} caulk_Lobby;\n\n");
+
+	emit(out, "typedef struct {\n");
+	emit(out, INDENT "size_t count;\n");
+	emit(out, INDENT "const caulk_Lobby* lobbies;\n");
+	emit(out, INDENT "const caulk_LobbyPair* pairs;\n");
+	emit(out, INDENT "const uint64_t* members;\n");
+	emit(out, INDENT "const uint32_t* member_values; // `CAULK_LOBBY_MEMBER_KEYS` per member\n");
+	emit(out, INDENT "const uint32_t* member_keys;\n");
+	emit(out, INDENT "size_t num_member_keys;\n");
+	emit(out, INDENT "const char* text;\n");
+	emit(out, "} caulk_LobbyCache;\n\n");
+
+	emit(out, "bool caulk_CacheLobby(uint64_t lobby);\n");
+	emit(out, "bool caulk_UncacheLobby(uint64_t lobby);\n");
+	emit(out, "bool caulk_CacheLobbyMemberKey(const char* key);\n");
+	emit(out, "const caulk_LobbyCache* caulk_GetLobbyCache();\n");
+	emit(out, "const char* caulk_GetCachedLobbyData(uint64_t lobby, const char* key);\n");
+	endCoreHeader(out);
+
+	out = beginCoreHeader("input.h", true);
+	emit(out, "typedef struct {\n");
+	emit(out, INDENT "bool *state, *active;\n");
+	emit(out, "} caulk_DigitalActionStates;\n\n");
+
+	emit(out, "typedef struct {\n");
+	emit(out, INDENT "float *x, *y;\n");
+	emit(out, INDENT "int32_t* mode;\n");
+	emit(out, INDENT "bool* active;\n");
+	emit(out, "} caulk_AnalogActionStates;\n\n");
+
+	emit(out,
+		"bool caulk_SteamInput_PollAll(const InputHandle_t* controllers, size_t num_controllers, "
+		"const InputDigitalActionHandle_t* digital_actions, size_t num_digital, "
+		"const InputAnalogActionHandle_t* analog_actions, size_t num_analog, "
+		"const caulk_DigitalActionStates* out_digital, const caulk_AnalogActionStates* out_analog);\n");
+	endCoreHeader(out);
+
+	out = beginCoreHeader("dispatchstats.h", false);
+	emit(out, "#define CAULK_STATS_BUCKETS 16\n\n");
+
+	emit(out, "typedef struct {\n");
+	emit(out, INDENT "uint32_t callback;\n");
+	emit(out, INDENT "uint64_t messages, bytes, unhandled, handler_ns;\n");
+	emit(out, INDENT "uint32_t histogram[CAULK_STATS_BUCKETS];\n");
+	emit(out, "} caulk_CallbackStats;\n\n");
+
+	emit(out, "typedef struct {\n");
+	emit(out, INDENT "const caulk_CallbackStats* callbacks;\n");
+	emit(out, INDENT "size_t num_callbacks, pending_results;\n");
+	emit(out, INDENT "uint64_t dropped_registrations, run_frame_ns;\n");
+	emit(out, "} caulk_DispatchStats;\n\n");
+
+	emit(out, "const caulk_DispatchStats* caulk_GetDispatchStats();\n");
+	emit(out, "void caulk_ResetDispatchStats();\n");
+	endCoreHeader(out);
+}
+
+int main(int argc, char* argv[]) {
+	uint64_t hash = HASH_SEED;
+	for (int i = 1; i < argc; i++)
+		hash = hashBytes(hash, argv[i], strlen(argv[i]) + 1);
+	bool hashed = hashFile(&hash, argv[0]);
+
+	if (argc > 1 && !strcmp(argv[1], "--direct"))
+		gDirect = true, argc--, argv++;
+
+	if (argc != 5 && argc != 6)
+		return EXIT_FAILURE;
+
+	const char *hName = argv[1], *cppName = argv[2], *apiName = argv[3], *jsonName = argv[4];
+	const char* mockName = argc > 5 ? argv[5] : NULL;
+
+	// the per-interface headers and the types they share go in `caulk/` next to the umbrella header
+	snprintf(gHeaderDir, sizeof(gHeaderDir), "%.*scaulk/", (int)(fileBasename(hName) - hName), hName);
+	static char baseName[1024] = {0}, typesName[1024] = {0}, coreName[1024] = {0};
+	snprintf(baseName, sizeof(baseName), "%sbase.h", gHeaderDir);
+	snprintf(typesName, sizeof(typesName), "%stypes.h", gHeaderDir);
+	snprintf(coreName, sizeof(coreName), "%score.h", gHeaderDir);
+
+	snprintf(gGlueStem, sizeof(gGlueStem), "%s", cppName);
+	char* extension = strrchr(gGlueStem, '.');
+	if (extension && extension > fileBasename(gGlueStem))
+		*extension = '\0';
+
+	static char stampName[1024] = {0};
+	snprintf(stampName, sizeof(stampName), "%s", gluePath(".stamp"));
+	hashed = hashed && hashFile(&hash, jsonName);
+	if (hashed && upToDate(stampName, hash))
+		return EXIT_SUCCESS;
+
+	// `__api.h` is both of these in one, for the glue; the public headers get them separately
+	static Output base = {0}, types = {0};
+	baseOutput = &base, apiOutput = typesOutput = &types, cppOutput = glueOutput = openOutput(cppName);
+	Output *apiHOutput = openOutput(apiName), *hOutput = openOutput(hName), *baseHOutput = openOutput(baseName),
+	       *typesHOutput = openOutput(typesName), *coreOutput = openOutput(coreName);
+	if (mockName)
+		mockOutput = openOutput(mockName);
+
+	yyjson_read_flag flg = YYJSON_READ_ALLOW_COMMENTS | YYJSON_READ_ALLOW_TRAILING_COMMAS;
+	yyjson_read_err err = {0};
+	gDoc = yyjson_read_file(jsonName, flg, NULL, &err);
+
+	if (!gDoc)
+		return EXIT_FAILURE;
 
-	fprintf(hOutput, "typedef void (*caulk_ResultHandler)(void*, bool);\n");
-	fprintf(hOutput, "typedef void (*caulk_CallbackHandler)(void*);\n\n");
+	emit(baseOutput, "#include <inttypes.h>\n\n");
 
-	fprintf(hOutput, "bool caulk_Init();\n");
-	fprintf(hOutput, "void caulk_Shutdown();\n");
-	fprintf(hOutput, "void caulk_Resolve(SteamAPICall_t, caulk_ResultHandler);\n");
-	fprintf(hOutput, "void caulk_Register(uint32_t, caulk_CallbackHandler);\n");
-	fprintf(hOutput, "void caulk_Dispatch();\n\n");
+	emit(baseOutput, "#define PRI_SteamID PRIu64\n");
+	emit(baseOutput, "#define PRI_CSteamID PRI_SteamID\n\n");
 
-	fprintf(hOutput, "#ifdef __cplusplus\n");
-	fprintf(hOutput, "}\n");
-	fprintf(hOutput, "#endif\n");
+	if (gDirect) {
+		emit(baseOutput, "#ifdef __cplusplus\n");
+		emit(baseOutput, "#define CAULK_FLAT extern \"C\"\n");
+		emit(baseOutput, "#else\n");
+		emit(baseOutput, "#define CAULK_FLAT extern\n");
+		emit(baseOutput, "#endif\n\n");
+	}
+
+	emit(baseOutput, "#ifdef __cplusplus\n");
+	emit(baseOutput, "extern \"C\" {\n");
+	emit(baseOutput, "#endif\n\n");
+
+	emit(baseOutput, "#ifndef CAULK_INTERNAL\n");
+	emit(baseOutput, "typedef int32_t SteamInputActionEvent_t__AnalogAction_t;\n"); // :(
+	emit(baseOutput, "typedef uint64_t CSteamID, CGameID;\n");
+	emit(baseOutput, "typedef void (*SteamAPIWarningMessageHook_t)(int, const char*);\n");
+	emit(baseOutput, "#endif\n\n");
+
+	emit(baseOutput, "#ifdef __cplusplus\n");
+	emit(baseOutput, "}\n");
+	emit(baseOutput, "#endif\n\n");
+
+	emit(cppOutput, "#include \"%s\"\n\n", fileBasename(gluePath(".h")));
+
+	emit(cppOutput, "extern \"C\" {\n\n");
+	genConstants(), genTypedefs(), genStructs(), genCallResultBuffer(), genCallbackSlots();
+	genInterfaceLoader();
+	emit(cppOutput, "}\n");
+	genGluePrelude(apiName);
+
+	emitN(apiHOutput, baseOutput->data, baseOutput->size);
+	emitN(apiHOutput, typesOutput->data, typesOutput->size);
+
+	emit(baseHOutput, "#pragma once\n\n");
+
+	emit(baseHOutput, "#include <stddef.h>\n");
+	emit(baseHOutput, "#include <stdint.h>\n");
+	emit(baseHOutput, "#include <stdbool.h>\n");
+	emit(baseHOutput, "#include <stdlib.h>\n");
+	emitN(baseHOutput, baseOutput->data, baseOutput->size);
+
+	emit(typesHOutput, "#pragma once\n\n");
+
+	emit(typesHOutput, "#include \"base.h\"\n\n");
+	emitN(typesHOutput, typesOutput->data, typesOutput->size);
+
+	genCoreHeaders();
+
+	emit(hOutput, "#pragma once\n\n");
+
+	emit(hOutput, "#include \"caulk/types.h\"\n");
+	emit(hOutput, "#include \"caulk/core.h\"\n");
+	for (size_t i = 0; i < gNumCoreHeaders; i++)
+		emit(hOutput, "#include \"caulk/core/%s\"\n", gCoreHeaders[i]);
+	for (size_t i = 0; i < gNumHeaders; i++)
+		emit(hOutput, "#include \"caulk/%s\"\n", gHeaders[i]);
+
+	emit(coreOutput, "#pragma once\n\n");
+
+	emit(coreOutput, "#include \"base.h\"\n\n");
+
+	emit(coreOutput, "#ifdef __cplusplus\n");
+	emit(coreOutput, "extern \"C\" {\n");
+	emit(coreOutput, "#endif\n\n");
+
+	emit(coreOutput, "typedef void (*caulk_ResultHandler)(void*, bool);\n");
+	emit(coreOutput, "typedef void (*caulk_CallbackHandler)(void*);\n");
+	emit(coreOutput, "typedef void (*caulk_ResultHandlerCtx)(void*, bool, void*);\n");
+	emit(coreOutput, "typedef void (*caulk_CallbackHandlerCtx)(void*, void*);\n");
+	emit(coreOutput, "typedef uint64_t caulk_Handle;\n\n");
+
+	emit(coreOutput, "typedef struct {\n");
+	emit(coreOutput, INDENT "size_t callback_capacity, result_capacity;\n");
+	emit(coreOutput, INDENT "void* (*alloc)(size_t size, void* userdata);\n");
+	emit(coreOutput, INDENT "void (*dealloc)(void* ptr, void* userdata);\n");
+	emit(coreOutput, INDENT "void* userdata;\n");
+	emit(coreOutput, INDENT "bool threaded;\n");
+	emit(coreOutput, INDENT "size_t queue_size;\n");
+	emit(coreOutput, INDENT "uint32_t pump_interval_us;\n");
+	emit(coreOutput, INDENT "size_t result_cache_size;\n");
+	emit(coreOutput, INDENT "uint32_t result_cache_frames;\n");
+	emit(coreOutput, INDENT "int friends_snapshot_flags;\n");
+	emit(coreOutput, INDENT "uint32_t stats_store_interval_ms;\n");
+	emit(coreOutput, "} caulk_Config;\n\n");
+
+	emit(coreOutput, "bool caulk_Init();\n");
+	emit(coreOutput, "bool caulk_InitEx(const caulk_Config*);\n");
+	emit(coreOutput, "void caulk_Shutdown();\n");
+	emit(coreOutput, "caulk_Handle caulk_Resolve(SteamAPICall_t, caulk_ResultHandler);\n");
+	emit(coreOutput, "caulk_Handle caulk_ResolveCtx(SteamAPICall_t, caulk_ResultHandlerCtx, void*);\n");
+	emit(coreOutput,
+		"caulk_Handle caulk_ResolveAs(SteamAPICall_t, uint32_t callback, caulk_ResultHandlerCtx, void*);\n");
+	emit(coreOutput,
+		"caulk_Handle caulk_ResolveWithTimeout(SteamAPICall_t, caulk_ResultHandlerCtx, void*, "
+		"uint32_t timeout_ms);\n");
+	emit(coreOutput, "bool caulk_Cancel(SteamAPICall_t);\n");
+	emit(coreOutput, "caulk_Handle caulk_Register(uint32_t, caulk_CallbackHandler);\n");
+	emit(coreOutput, "caulk_Handle caulk_RegisterCtx(uint32_t, caulk_CallbackHandlerCtx, void*);\n");
+	emit(coreOutput, "bool caulk_Unregister(caulk_Handle);\n");
+	emit(coreOutput, "bool caulk_Coalesce(uint32_t callback, bool enable);\n");
+	emit(coreOutput, "void caulk_Dispatch();\n");
+	emit(coreOutput, "bool caulk_DispatchBudget(uint32_t max_us, size_t max_callbacks);\n");
+	emit(coreOutput, "size_t caulk_QueuedMessages();\n");
+	emit(coreOutput, "size_t caulk_DroppedMessages();\n");
+	emit(coreOutput, "\n");
+
+	genTypedRegistration(coreOutput);
+
+	// caulk's sources see the SDK's interface classes, and read the same pointers their calls into Steam go through
+	emit(coreOutput, "#ifdef CAULK_INTERNAL\n");
+	emit(coreOutput, "void caulk_LoadInterfaces();\n");
+	emit(coreOutput, "void caulk_UnloadInterfaces();\n");
+	for (size_t i = 0; i < gNumInterfaces; i++)
+		emit(coreOutput, "extern %s* %s;\n", gInterfaces[i], interfaceVar(gInterfaces[i]));
+	emit(coreOutput, "#endif\n\n");
+
+	emit(coreOutput, "#ifdef __cplusplus\n");
+	emit(coreOutput, "}\n");
+	emit(coreOutput, "#endif\n");
 
 	yyjson_doc_free(gDoc);
-	fclose(cppOutput), fclose(hOutput);
+
+	// written last, so a run that fails halfway never looks up to date
+	if (hashed) {
+		Output* stamp = openOutput(stampName);
+		emit(stamp, "%016" PRIx64 "\n", hash);
+		for (size_t i = 0; i + 1 < gNumOutputs; i++)
+			emit(stamp, "%s\n", gOutputs[i].path);
+	}
+	writeOutputs();
 
 	return EXIT_SUCCESS;
 }
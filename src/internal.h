@@ -0,0 +1,88 @@
+// This is free and unencumbered software released into the public domain.
+//
+// Anyone is free to copy, modify, publish, use, compile, sell, or
+// distribute this software, either in source code form or as a compiled
+// binary, for any purpose, commercial or non-commercial, and by any
+// means.
+//
+// In jurisdictions that recognize copyright laws, the author or authors
+// of this software dedicate any and all copyright interest in the
+// software to the public domain. We make this dedication for the benefit
+// of the public at large and to the detriment of our heirs and
+// successors. We intend this dedication to be an overt act of
+// relinquishment in perpetuity of all present and future rights to this
+// software under copyright law.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+// EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+// MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+// IN NO EVENT SHALL THE AUTHORS BE LIABLE FOR ANY CLAIM, DAMAGES OR
+// OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE,
+// ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR
+// OTHER DEALINGS IN THE SOFTWARE.
+//
+// For more information, please refer to <https://unlicense.org>
+
+// What caulk.cpp shares with the subsystems kept in their own files. These have external linkage, hence the prefix.
+
+#pragma once
+
+#include <chrono>
+#include <steam_api.h>
+#include <steam_api_flat.h>
+#include <string.h>
+
+#define CAULK_INTERNAL
+#include "caulk.h"
+
+#define LENGTH(expr) (sizeof((expr)) / sizeof(*(expr)))
+#define PADDED(size) (((size_t)(size) + 7) & ~(size_t)7)
+
+extern "C" {
+extern caulk_Config caulk_config;
+
+// Moves `*array` into a fresh block of `new_count` elements, keeping the first `old_count`.
+bool caulk_grow_array(void* array, size_t size, size_t old_count, size_t new_count);
+// whether `caulk_InitEx()` got as far as setting up the handler tables
+bool caulk_initialized();
+caulk_Handle caulk_subscribe(uint32_t callback, caulk_CallbackHandlerCtx handler, void* ctx);
+// milliseconds on the same clock as the timer wheel
+uint64_t caulk_current_tick();
+
+// Everything that comes out of Steam goes through one of these. Calling handlers, draining into caller memory with
+// `caulk_DispatchInto()` and feeding the threaded mode's queue are all just different sinks behind the same loop.
+typedef struct Sink Sink;
+struct Sink {
+	// whether there's room for this many messages carrying `bytes` of payload (each rounded up to 8 bytes)
+	bool (*fits)(Sink*, size_t messages, size_t bytes);
+	// where to copy a call result of `size` bytes before handing it to `result`
+	void* (*result_buffer)(Sink*, size_t size);
+	void (*result)(Sink*, SteamAPICall_t call, int32_t callback, void* data, uint32_t size, bool io_failed);
+	void (*callback)(Sink*, int32_t callback, void* data, uint32_t size);
+};
+
+bool caulk_handlers_fit(Sink* sink, size_t messages, size_t bytes);
+void caulk_run_frame(HSteamPipe steam_pipe);
+void caulk_dispatch_message(Sink* sink, HSteamPipe steam_pipe, const CallbackMsg_t* callback);
+bool caulk_over_budget(std::chrono::steady_clock::time_point start, uint32_t max_us, size_t max_callbacks,
+	size_t dispatched);
+
+// queue.cpp
+bool caulk_start_pump();
+void caulk_stop_pump();
+// whether the pump thread owns the pipe, and `caulk_dispatch_queue()` is where messages come from
+bool caulk_pumping();
+bool caulk_dispatch_queue(Sink* sink, uint32_t max_us, size_t max_callbacks);
+
+// friends.cpp
+bool caulk_load_friends();
+void caulk_free_friends();
+
+// stats.cpp
+void caulk_store_user_stats();
+void caulk_free_user_stats();
+
+// lobbies.cpp
+void caulk_refresh_lobbies();
+void caulk_free_lobbies();
+}
@@ -0,0 +1,436 @@
+// This is free and unencumbered software released into the public domain.
+//
+// Anyone is free to copy, modify, publish, use, compile, sell, or
+// distribute this software, either in source code form or as a compiled
+// binary, for any purpose, commercial or non-commercial, and by any
+// means.
+//
+// In jurisdictions that recognize copyright laws, the author or authors
+// of this software dedicate any and all copyright interest in the
+// software to the public domain. We make this dedication for the benefit
+// of the public at large and to the detriment of our heirs and
+// successors. We intend this dedication to be an overt act of
+// relinquishment in perpetuity of all present and future rights to this
+// software under copyright law.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+// EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+// MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+// IN NO EVENT SHALL THE AUTHORS BE LIABLE FOR ANY CLAIM, DAMAGES OR
+// OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE,
+// ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR
+// OTHER DEALINGS IN THE SOFTWARE.
+//
+// For more information, please refer to <https://unlicense.org>
+
+#include "internal.h"
+
+extern "C" {
+// The lobby cache: each tracked lobby's data and members, read again on the dispatch after Steam says they changed.
+// Pairs and members are ranges of shared arrays, and keys and values are interned into `text`.
+#define LOBBY_KEY_SIZE (256) // `k_nMaxLobbyKeyLength`
+#define LOBBY_VALUE_SIZE (8192) // `k_cubChatMetadataMax`
+
+typedef struct {
+	caulk_LobbyCache view;
+	size_t capacity;
+	caulk_Lobby* lobbies;
+	uint32_t* index; // by lobby ID, `position + 1`, twice `capacity` slots
+	bool* stale;
+	uint64_t* stale_ids;
+	size_t num_stale;
+
+	caulk_LobbyPair* pairs;
+	size_t pairs_used, pairs_size, pairs_live;
+	uint64_t* members;
+	uint32_t* member_values; // `CAULK_LOBBY_MEMBER_KEYS` for every member
+	size_t members_used, members_size, members_live;
+	uint32_t member_keys[CAULK_LOBBY_MEMBER_KEYS];
+	size_t num_member_keys;
+
+	char* text;
+	size_t text_used, text_size, text_compacted;
+	uint32_t* interned; // open-addressed by string hash, `offset + 1`
+	size_t intern_capacity, num_interned;
+} Lobbies;
+
+static Lobbies lobbies = {};
+
+static uint32_t hash_text(const char* str) {
+	uint32_t hash = 2166136261u;
+	for (; *str; str++)
+		hash = (hash ^ (uint8_t)*str) * 16777619u;
+	return hash;
+}
+
+// Finds the bucket `str` is in, or the empty one it would go in.
+static uint32_t* intern_bucket(const char* str) {
+	size_t mask = lobbies.intern_capacity - 1;
+	for (size_t bucket = hash_text(str) & mask;; bucket = (bucket + 1) & mask) {
+		uint32_t* slot = &lobbies.interned[bucket];
+		if (!*slot || !strcmp(lobbies.text + *slot - 1, str))
+			return slot;
+	}
+}
+
+static bool grow_interned() {
+	size_t capacity = lobbies.intern_capacity ? lobbies.intern_capacity * 2 : 256;
+	uint32_t* old = lobbies.interned;
+	size_t old_capacity = lobbies.intern_capacity;
+
+	lobbies.interned = (uint32_t*)caulk_config.alloc(capacity * sizeof(uint32_t), caulk_config.userdata);
+	if (!lobbies.interned) {
+		lobbies.interned = old;
+		return false;
+	}
+	memset(lobbies.interned, 0, capacity * sizeof(uint32_t));
+	lobbies.intern_capacity = capacity;
+
+	for (size_t idx = 0; idx < old_capacity; idx++)
+		if (old[idx])
+			*intern_bucket(lobbies.text + old[idx] - 1) = old[idx];
+	if (old)
+		caulk_config.dealloc(old, caulk_config.userdata);
+	return true;
+}
+
+// Returns the offset of `str` in `text`, adding it if it isn't there yet; 0 (an empty string) when out of memory.
+static uint32_t intern_text(const char* str) {
+	if (!*str || ((lobbies.num_interned + 1) * 2 > lobbies.intern_capacity && !grow_interned()))
+		return 0;
+
+	uint32_t* slot = intern_bucket(str);
+	if (*slot)
+		return *slot - 1;
+
+	size_t len = strlen(str) + 1;
+	if (lobbies.text_used + len > lobbies.text_size) {
+		size_t size = lobbies.text_size * 2 + len;
+		if (!caulk_grow_array(&lobbies.text, 1, lobbies.text_used, size))
+			return 0;
+		lobbies.text_size = size;
+	}
+
+	uint32_t offset = (uint32_t)lobbies.text_used;
+	memcpy(lobbies.text + offset, str, len);
+	lobbies.text_used += len, lobbies.num_interned++;
+	*slot = offset + 1;
+	return offset;
+}
+
+static bool reset_text(size_t size) {
+	lobbies.text = (char*)caulk_config.alloc(size, caulk_config.userdata);
+	if (!lobbies.text)
+		return false;
+	lobbies.text[0] = '\0'; // offset 0 is always the empty string
+	lobbies.text_used = 1, lobbies.text_size = size;
+	lobbies.num_interned = 0;
+	if (lobbies.interned)
+		memset(lobbies.interned, 0, lobbies.intern_capacity * sizeof(uint32_t));
+	return true;
+}
+
+// Interns everything still in use into a new `text`, dropping whatever nothing points at anymore.
+static void compact_text() {
+	char* old = lobbies.text;
+	if (!reset_text(lobbies.text_compacted > 4096 ? lobbies.text_compacted : 4096)) {
+		lobbies.text = old;
+		return;
+	}
+
+	for (size_t pos = 0; pos < lobbies.view.count; pos++) {
+		const caulk_Lobby* lobby = &lobbies.lobbies[pos];
+		for (uint32_t idx = lobby->first_pair; idx < lobby->first_pair + lobby->num_pairs; idx++) {
+			lobbies.pairs[idx].key = intern_text(old + lobbies.pairs[idx].key);
+			lobbies.pairs[idx].value = intern_text(old + lobbies.pairs[idx].value);
+		}
+		for (uint32_t idx = lobby->first_member; idx < lobby->first_member + lobby->num_members; idx++)
+			for (size_t key = 0; key < lobbies.num_member_keys; key++) {
+				uint32_t* value = &lobbies.member_values[idx * CAULK_LOBBY_MEMBER_KEYS + key];
+				*value = intern_text(old + *value);
+			}
+	}
+	for (size_t key = 0; key < lobbies.num_member_keys; key++)
+		lobbies.member_keys[key] = intern_text(old + lobbies.member_keys[key]);
+
+	caulk_config.dealloc(old, caulk_config.userdata);
+	lobbies.text_compacted = lobbies.text_used;
+}
+
+// Packs every live range to the front of a new set of arrays with room for `extra_pairs` and `extra_members` more.
+static bool compact_ranges(size_t extra_pairs, size_t extra_members) {
+	size_t pairs_size = (lobbies.pairs_live + extra_pairs) * 2 + 64;
+	size_t members_size = (lobbies.members_live + extra_members) * 2 + 16;
+	caulk_LobbyPair* pairs
+		= (caulk_LobbyPair*)caulk_config.alloc(pairs_size * sizeof(caulk_LobbyPair), caulk_config.userdata);
+	uint64_t* members = (uint64_t*)caulk_config.alloc(members_size * sizeof(uint64_t), caulk_config.userdata);
+	uint32_t* values = (uint32_t*)caulk_config.alloc(
+		members_size * CAULK_LOBBY_MEMBER_KEYS * sizeof(uint32_t), caulk_config.userdata);
+	if (!pairs || !members || !values) {
+		void* arrays[] = {pairs, members, values};
+		for (size_t idx = 0; idx < LENGTH(arrays); idx++)
+			if (arrays[idx])
+				caulk_config.dealloc(arrays[idx], caulk_config.userdata);
+		return false;
+	}
+
+	size_t num_pairs = 0, num_members = 0;
+	for (size_t pos = 0; pos < lobbies.view.count; pos++) {
+		caulk_Lobby* lobby = &lobbies.lobbies[pos];
+		memcpy(pairs + num_pairs, &lobbies.pairs[lobby->first_pair], lobby->num_pairs * sizeof(*pairs));
+		memcpy(members + num_members, &lobbies.members[lobby->first_member],
+			lobby->num_members * sizeof(*members));
+		memcpy(values + num_members * CAULK_LOBBY_MEMBER_KEYS,
+			lobbies.member_values + (size_t)lobby->first_member * CAULK_LOBBY_MEMBER_KEYS,
+			lobby->num_members * CAULK_LOBBY_MEMBER_KEYS * sizeof(uint32_t));
+		lobby->first_pair = (uint32_t)num_pairs, lobby->first_member = (uint32_t)num_members;
+		num_pairs += lobby->num_pairs, num_members += lobby->num_members;
+	}
+
+	void* arrays[] = {lobbies.pairs, lobbies.members, lobbies.member_values};
+	for (size_t idx = 0; idx < LENGTH(arrays); idx++)
+		if (arrays[idx])
+			caulk_config.dealloc(arrays[idx], caulk_config.userdata);
+	lobbies.pairs = pairs, lobbies.pairs_used = num_pairs, lobbies.pairs_size = pairs_size;
+	lobbies.members = members, lobbies.member_values = values;
+	lobbies.members_used = num_members, lobbies.members_size = members_size;
+	return true;
+}
+
+static bool reserve_ranges(size_t num_pairs, size_t num_members) {
+	if (lobbies.pairs_used + num_pairs <= lobbies.pairs_size
+		&& lobbies.members_used + num_members <= lobbies.members_size)
+		return true;
+	return compact_ranges(num_pairs, num_members);
+}
+
+static size_t lobby_bucket(uint64_t id) {
+	return (size_t)((id * UINT64_C(0x9E3779B97F4A7C15)) >> 32) & (lobbies.capacity * 2 - 1);
+}
+
+static void index_lobby(size_t pos) {
+	size_t bucket = lobby_bucket(lobbies.lobbies[pos].id);
+	while (lobbies.index[bucket])
+		bucket = (bucket + 1) & (lobbies.capacity * 2 - 1);
+	lobbies.index[bucket] = (uint32_t)pos + 1;
+}
+
+static void index_lobbies() {
+	memset(lobbies.index, 0, lobbies.capacity * 2 * sizeof(uint32_t));
+	for (size_t pos = 0; pos < lobbies.view.count; pos++)
+		index_lobby(pos);
+}
+
+static int64_t find_lobby(uint64_t id) {
+	if (!lobbies.capacity)
+		return -1;
+	size_t mask = lobbies.capacity * 2 - 1;
+	for (size_t bucket = lobby_bucket(id); lobbies.index[bucket]; bucket = (bucket + 1) & mask)
+		if (lobbies.lobbies[lobbies.index[bucket] - 1].id == id)
+			return lobbies.index[bucket] - 1;
+	return -1;
+}
+
+static bool grow_lobbies() {
+	size_t old = lobbies.capacity, capacity = old ? old * 2 : 32;
+	if (!caulk_grow_array(&lobbies.lobbies, sizeof(caulk_Lobby), old, capacity)
+		|| !caulk_grow_array(&lobbies.stale, sizeof(bool), old, capacity)
+		|| !caulk_grow_array(&lobbies.stale_ids, sizeof(uint64_t), old, capacity))
+		return false;
+
+	uint32_t* index = (uint32_t*)caulk_config.alloc(capacity * 2 * sizeof(uint32_t), caulk_config.userdata);
+	if (!index)
+		return false;
+	if (lobbies.index)
+		caulk_config.dealloc(lobbies.index, caulk_config.userdata);
+	lobbies.index = index, lobbies.capacity = capacity;
+	index_lobbies();
+	return true;
+}
+
+static void mark_lobby(size_t pos) {
+	if (lobbies.stale[pos])
+		return;
+	lobbies.stale[pos] = true;
+	lobbies.stale_ids[lobbies.num_stale++] = lobbies.lobbies[pos].id;
+}
+
+static void on_lobby_data_update(void* data, void* ctx) {
+	(void)ctx;
+	int64_t pos = find_lobby(reinterpret_cast<const LobbyDataUpdate_t*>(data)->m_ulSteamIDLobby);
+	if (pos >= 0)
+		mark_lobby((size_t)pos);
+}
+
+static void on_lobby_chat_update(void* data, void* ctx) {
+	(void)ctx;
+	int64_t pos = find_lobby(reinterpret_cast<const LobbyChatUpdate_t*>(data)->m_ulSteamIDLobby);
+	if (pos >= 0)
+		mark_lobby((size_t)pos);
+}
+
+// Fails, leaving the lobby as it was, when there's no memory for its new ranges.
+static bool load_lobby(caulk_Lobby* lobby) {
+	static char key[LOBBY_KEY_SIZE], value[LOBBY_VALUE_SIZE];
+	ISteamMatchmaking* iface = caulk_gSteamMatchmaking;
+
+	int num_pairs = SteamAPI_ISteamMatchmaking_GetLobbyDataCount(iface, lobby->id);
+	int num_members = SteamAPI_ISteamMatchmaking_GetNumLobbyMembers(iface, lobby->id);
+	num_pairs = num_pairs > 0 ? num_pairs : 0, num_members = num_members > 0 ? num_members : 0;
+	if (!reserve_ranges((size_t)num_pairs, (size_t)num_members))
+		return false;
+	lobbies.pairs_live -= lobby->num_pairs, lobbies.members_live -= lobby->num_members;
+	lobby->num_pairs = lobby->num_members = 0;
+
+	lobby->first_pair = (uint32_t)lobbies.pairs_used;
+	for (int idx = 0; idx < num_pairs; idx++) {
+		if (!SteamAPI_ISteamMatchmaking_GetLobbyDataByIndex(
+				iface, lobby->id, idx, key, sizeof(key), value, sizeof(value)))
+			continue;
+		caulk_LobbyPair* pair = &lobbies.pairs[lobbies.pairs_used++];
+		pair->key = intern_text(key), pair->value = intern_text(value);
+		lobby->num_pairs++;
+	}
+
+	lobby->first_member = (uint32_t)lobbies.members_used;
+	for (int idx = 0; idx < num_members; idx++) {
+		uint64_t member = SteamAPI_ISteamMatchmaking_GetLobbyMemberByIndex(iface, lobby->id, idx);
+		uint32_t* values = &lobbies.member_values[lobbies.members_used * CAULK_LOBBY_MEMBER_KEYS];
+		memset(values, 0, CAULK_LOBBY_MEMBER_KEYS * sizeof(uint32_t));
+		for (size_t key_idx = 0; key_idx < lobbies.num_member_keys; key_idx++) {
+			const char* data = SteamAPI_ISteamMatchmaking_GetLobbyMemberData(
+				iface, lobby->id, member, lobbies.text + lobbies.member_keys[key_idx]);
+			values[key_idx] = intern_text(data ? data : "");
+		}
+		lobbies.members[lobbies.members_used++] = member;
+		lobby->num_members++;
+	}
+	lobbies.pairs_live += lobby->num_pairs, lobbies.members_live += lobby->num_members;
+	return true;
+}
+
+void caulk_refresh_lobbies() {
+	if (!lobbies.num_stale)
+		return;
+
+	// a lobby that couldn't be loaded stays stale, so the next dispatch tries it again
+	size_t still_stale = 0;
+	for (size_t idx = 0; idx < lobbies.num_stale; idx++) {
+		int64_t pos = find_lobby(lobbies.stale_ids[idx]);
+		if (pos < 0 || !lobbies.stale[pos])
+			continue; // untracked since
+		if (load_lobby(&lobbies.lobbies[pos]))
+			lobbies.stale[pos] = false;
+		else
+			lobbies.stale_ids[still_stale++] = lobbies.stale_ids[idx];
+	}
+	lobbies.num_stale = still_stale;
+
+	if (lobbies.text_used > lobbies.text_compacted * 2)
+		compact_text();
+}
+
+void caulk_free_lobbies() {
+	void* arrays[] = {lobbies.lobbies, lobbies.index, lobbies.stale, lobbies.stale_ids, lobbies.pairs,
+		lobbies.members, lobbies.member_values, lobbies.text, lobbies.interned};
+	for (size_t idx = 0; idx < LENGTH(arrays); idx++)
+		if (arrays[idx])
+			caulk_config.dealloc(arrays[idx], caulk_config.userdata);
+	lobbies = {};
+}
+
+// Everything's set up on first use, so that a game without lobbies doesn't pay for them.
+static bool init_lobbies() {
+	if (lobbies.text)
+		return true;
+	if (!caulk_initialized() || !reset_text(4096) || !grow_interned() || !grow_lobbies()
+		|| !caulk_subscribe(LobbyDataUpdate_t_iCallback, on_lobby_data_update, NULL)
+		|| !caulk_subscribe(LobbyChatUpdate_t_iCallback, on_lobby_chat_update, NULL)) {
+		caulk_free_lobbies();
+		return false;
+	}
+	lobbies.text_compacted = 4096;
+	return true;
+}
+
+bool caulk_CacheLobby(uint64_t lobby) {
+	if (!lobby || !init_lobbies())
+		return false;
+	if (find_lobby(lobby) >= 0)
+		return true;
+	if (lobbies.view.count == lobbies.capacity && !grow_lobbies())
+		return false;
+
+	size_t pos = lobbies.view.count++;
+	lobbies.lobbies[pos] = {lobby, 0, 0, 0, 0};
+	lobbies.stale[pos] = false;
+	index_lobby(pos);
+	mark_lobby(pos);
+	return true;
+}
+
+// The last lobby moves into the gap.
+bool caulk_UncacheLobby(uint64_t lobby) {
+	int64_t pos = find_lobby(lobby);
+	if (pos < 0)
+		return false;
+
+	if (lobbies.stale[pos])
+		for (size_t idx = 0; idx < lobbies.num_stale; idx++)
+			if (lobbies.stale_ids[idx] == lobby) {
+				lobbies.stale_ids[idx] = lobbies.stale_ids[--lobbies.num_stale];
+				break;
+			}
+
+	lobbies.pairs_live -= lobbies.lobbies[pos].num_pairs, lobbies.members_live -= lobbies.lobbies[pos].num_members;
+	size_t last = --lobbies.view.count;
+	lobbies.lobbies[pos] = lobbies.lobbies[last], lobbies.stale[pos] = lobbies.stale[last];
+	index_lobbies();
+	return true;
+}
+
+bool caulk_CacheLobbyMemberKey(const char* key) {
+	if (!key || !*key || !init_lobbies())
+		return false;
+
+	uint32_t offset = intern_text(key);
+	for (size_t idx = 0; idx < lobbies.num_member_keys; idx++)
+		if (lobbies.member_keys[idx] == offset)
+			return true;
+	if (!offset || lobbies.num_member_keys == CAULK_LOBBY_MEMBER_KEYS)
+		return false;
+
+	lobbies.member_keys[lobbies.num_member_keys++] = offset;
+	for (size_t pos = 0; pos < lobbies.view.count; pos++)
+		mark_lobby(pos);
+	return true;
+}
+
+const caulk_LobbyCache* caulk_GetLobbyCache() {
+	if (!lobbies.text)
+		return NULL;
+
+	lobbies.view.lobbies = lobbies.lobbies, lobbies.view.pairs = lobbies.pairs;
+	lobbies.view.members = lobbies.members, lobbies.view.member_values = lobbies.member_values;
+	lobbies.view.member_keys = lobbies.member_keys, lobbies.view.num_member_keys = lobbies.num_member_keys;
+	lobbies.view.text = lobbies.text;
+	return &lobbies.view;
+}
+
+const char* caulk_GetCachedLobbyData(uint64_t lobby, const char* key) {
+	int64_t pos = find_lobby(lobby);
+	if (pos < 0 || !key)
+		return NULL;
+
+	// an interned key can be compared by offset, and one that isn't interned isn't in any lobby
+	uint32_t offset = *intern_bucket(key);
+	if (!offset)
+		return "";
+
+	const caulk_Lobby* found = &lobbies.lobbies[pos];
+	for (uint32_t idx = found->first_pair; idx < found->first_pair + found->num_pairs; idx++)
+		if (lobbies.pairs[idx].key == offset - 1)
+			return lobbies.text + lobbies.pairs[idx].value;
+	return "";
+}
+}
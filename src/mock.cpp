@@ -0,0 +1,457 @@
+// This is free and unencumbered software released into the public domain.
+//
+// Anyone is free to copy, modify, publish, use, compile, sell, or
+// distribute this software, either in source code form or as a compiled
+// binary, for any purpose, commercial or non-commercial, and by any
+// means.
+//
+// In jurisdictions that recognize copyright laws, the author or authors
+// of this software dedicate any and all copyright interest in the
+// software to the public domain. We make this dedication for the benefit
+// of the public at large and to the detriment of our heirs and
+// successors. We intend this dedication to be an overt act of
+// relinquishment in perpetuity of all present and future rights to this
+// software under copyright law.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+// EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+// MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+// IN NO EVENT SHALL THE AUTHORS BE LIABLE FOR ANY CLAIM, DAMAGES OR
+// OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE,
+// ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR
+// OTHER DEALINGS IN THE SOFTWARE.
+//
+// For more information, please refer to <https://unlicense.org>
+
+#include <mutex>
+#include <stdio.h>
+#include <steam_api_flat.h>
+#include <string.h>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include "mock.h"
+
+#define MOCK_STEAM_ID (76561197960265728ull)
+
+// Everything `caulk_Mock*()` posts lands in `incoming` first. Only the pipe's owner (the thread running frames) moves
+// it over to `delivery`, so payload pointers handed out by `GetNextCallback` stay put until the next frame.
+typedef struct {
+	int32_t callback;
+	size_t offset;
+	uint32_t size;
+} Message;
+
+typedef struct {
+	std::vector<Message> messages;
+	std::vector<uint8_t> payloads;
+} MessageQueue;
+
+typedef struct {
+	int32_t callback;
+	std::vector<uint8_t> data;
+	bool io_failed;
+	uint32_t delay_frames;
+	bool completed;
+} Call;
+
+typedef struct {
+	int32_t callback;
+	std::vector<uint8_t> data;
+	uint32_t per_frame;
+	uint64_t sequence;
+} Stream;
+
+static std::mutex lock;
+static MessageQueue incoming, delivery;
+static size_t next_message = 0;
+static bool fetched = false;
+
+static std::unordered_map<SteamAPICall_t, Call> calls;
+static std::vector<SteamAPICall_t> pending_calls;
+static SteamAPICall_t next_call = 1;
+
+static std::vector<Stream> streams;
+static uint64_t frames = 0;
+static int num_friends = 0;
+static int num_lobby_keys = 0;
+static std::unordered_map<std::string, uint32_t> user_stats; // raw bits, whatever the stat's type
+static int store_result = k_EResultOK;
+static uint64_t stores = 0;
+
+// what `SteamInternal_ContextInit()` compares against, bumped on init and shutdown so cached interfaces get refetched
+static uintptr_t context_counter = 1;
+static char interfaces[1];
+
+static void push_message(MessageQueue* queue, int32_t callback, const void* data, uint32_t size) {
+	size_t offset = queue->payloads.size();
+	queue->payloads.insert(queue->payloads.end(), (const uint8_t*)data, (const uint8_t*)data + size);
+	queue->messages.push_back({callback, offset, size});
+}
+
+extern "C" {
+void caulk_MockReset() {
+	std::lock_guard<std::mutex> guard(lock);
+	incoming.messages.clear(), incoming.payloads.clear();
+	delivery.messages.clear(), delivery.payloads.clear();
+	next_message = 0, fetched = false;
+	calls.clear(), pending_calls.clear(), streams.clear();
+	user_stats.clear(), num_friends = 0, num_lobby_keys = 0;
+	store_result = k_EResultOK, stores = 0;
+}
+
+void caulk_MockPost(int32_t callback, const void* data, uint32_t size) {
+	std::lock_guard<std::mutex> guard(lock);
+	push_message(&incoming, callback, data, size);
+}
+
+uint64_t caulk_MockCall(int32_t callback, const void* data, uint32_t size, bool io_failed, uint32_t delay_frames) {
+	std::lock_guard<std::mutex> guard(lock);
+	SteamAPICall_t call = next_call++;
+	calls[call] = {callback, std::vector<uint8_t>((const uint8_t*)data, (const uint8_t*)data + size), io_failed,
+		delay_frames, false};
+	pending_calls.push_back(call);
+	return call;
+}
+
+void caulk_MockStream(int32_t callback, const void* data, uint32_t size, uint32_t per_frame) {
+	std::lock_guard<std::mutex> guard(lock);
+	for (size_t i = 0; i < streams.size(); i++)
+		if (streams[i].callback == callback) {
+			streams.erase(streams.begin() + i);
+			break;
+		}
+
+	if (per_frame)
+		streams.push_back({callback, std::vector<uint8_t>((const uint8_t*)data, (const uint8_t*)data + size),
+			per_frame, 0});
+}
+
+void caulk_MockSetFriends(int count) {
+	num_friends = count;
+}
+
+void caulk_MockSetLobbyKeys(int count) {
+	num_lobby_keys = count;
+}
+
+uint64_t caulk_MockFrames() {
+	std::lock_guard<std::mutex> guard(lock);
+	return frames;
+}
+
+void caulk_MockSetStoreResult(int result) {
+	std::lock_guard<std::mutex> guard(lock);
+	store_result = result;
+}
+
+uint64_t caulk_MockStores() {
+	std::lock_guard<std::mutex> guard(lock);
+	return stores;
+}
+}
+
+S_API ESteamAPIInitResult S_CALLTYPE SteamInternal_SteamAPI_Init(const char* versions, SteamErrMsg* out_error) {
+	(void)versions, (void)out_error;
+	context_counter++;
+	return k_ESteamAPIInitResult_OK;
+}
+
+S_API void S_CALLTYPE SteamAPI_Shutdown() {
+	context_counter++;
+}
+
+S_API HSteamPipe S_CALLTYPE SteamAPI_GetHSteamPipe() {
+	return 1;
+}
+
+S_API HSteamUser S_CALLTYPE SteamAPI_GetHSteamUser() {
+	return 1;
+}
+
+S_API HSteamPipe S_CALLTYPE SteamGameServer_GetHSteamPipe() {
+	return 2;
+}
+
+S_API HSteamUser S_CALLTYPE SteamGameServer_GetHSteamUser() {
+	return 2;
+}
+
+// The accessors (`SteamFriends()` & co.) keep `{init function, counter, interface}` and call back in here.
+S_API void* S_CALLTYPE SteamInternal_ContextInit(void* context) {
+	void** data = (void**)context;
+	if ((uintptr_t)data[1] != context_counter) {
+		((void (*)(void*))data[0])(&data[2]);
+		data[1] = (void*)context_counter;
+	}
+	return &data[2];
+}
+
+S_API void* S_CALLTYPE SteamInternal_CreateInterface(const char* version) {
+	(void)version;
+	return interfaces;
+}
+
+S_API void* S_CALLTYPE SteamInternal_FindOrCreateUserInterface(HSteamUser user, const char* version) {
+	(void)user, (void)version;
+	return interfaces;
+}
+
+S_API void* S_CALLTYPE SteamInternal_FindOrCreateGameServerInterface(HSteamUser user, const char* version) {
+	(void)user, (void)version;
+	return interfaces;
+}
+
+S_API void S_CALLTYPE SteamAPI_ManualDispatch_Init() {}
+
+S_API void S_CALLTYPE SteamAPI_ManualDispatch_RunFrame(HSteamPipe pipe) {
+	(void)pipe;
+	std::lock_guard<std::mutex> guard(lock);
+	frames++;
+
+	if (next_message == delivery.messages.size()) {
+		delivery.messages.clear(), delivery.payloads.clear();
+		next_message = 0;
+	}
+
+	for (size_t i = 0; i < incoming.messages.size(); i++) {
+		const Message* message = &incoming.messages[i];
+		push_message(&delivery, message->callback, &incoming.payloads[message->offset], message->size);
+	}
+	incoming.messages.clear(), incoming.payloads.clear();
+
+	for (size_t i = 0; i < streams.size(); i++) {
+		Stream* stream = &streams[i];
+		for (uint32_t j = 0; j < stream->per_frame; j++, stream->sequence++) {
+			if (stream->data.size() >= sizeof(stream->sequence))
+				memcpy(stream->data.data(), &stream->sequence, sizeof(stream->sequence));
+			push_message(&delivery, stream->callback, stream->data.data(), (uint32_t)stream->data.size());
+		}
+	}
+
+	size_t still_pending = 0;
+	for (size_t i = 0; i < pending_calls.size(); i++) {
+		SteamAPICall_t handle = pending_calls[i];
+		Call* call = &calls[handle];
+		if (call->delay_frames) {
+			call->delay_frames--;
+			pending_calls[still_pending++] = handle;
+			continue;
+		}
+
+		call->completed = true;
+		SteamAPICallCompleted_t completed = {};
+		completed.m_hAsyncCall = handle;
+		completed.m_iCallback = call->callback;
+		completed.m_cubParam = (uint32)call->data.size();
+		push_message(&delivery, SteamAPICallCompleted_t::k_iCallback, &completed, sizeof(completed));
+	}
+	pending_calls.resize(still_pending);
+}
+
+S_API bool S_CALLTYPE SteamAPI_ManualDispatch_GetNextCallback(HSteamPipe pipe, CallbackMsg_t* out) {
+	if (next_message == delivery.messages.size())
+		return false;
+
+	const Message* message = &delivery.messages[next_message];
+	out->m_hSteamUser = pipe;
+	out->m_iCallback = message->callback;
+	out->m_pubParam = &delivery.payloads[message->offset];
+	out->m_cubParam = (int)message->size;
+	fetched = true;
+	return true;
+}
+
+S_API void S_CALLTYPE SteamAPI_ManualDispatch_FreeLastCallback(HSteamPipe pipe) {
+	(void)pipe;
+	if (fetched)
+		next_message++, fetched = false;
+}
+
+S_API bool S_CALLTYPE SteamAPI_ManualDispatch_GetAPICallResult(HSteamPipe pipe, SteamAPICall_t handle, void* out,
+	int size, int expected_callback, bool* out_failed) {
+	(void)pipe;
+	std::lock_guard<std::mutex> guard(lock);
+
+	auto iter = calls.find(handle);
+	if (iter == calls.end() || !iter->second.completed || iter->second.callback != expected_callback
+		|| (size_t)size < iter->second.data.size())
+		return false;
+
+	memcpy(out, iter->second.data.data(), iter->second.data.size());
+	*out_failed = iter->second.io_failed;
+	calls.erase(iter);
+	return true;
+}
+
+// Just enough of `ISteamFriends` and `ISteamUser` to enumerate friends, of `ISteamMatchmaking` to read lobby data, of
+// `ISteamInput` to read actions and of `ISteamUserStats` to store stats; every other flat function is a stub that
+// returns zero (or an empty string).
+#define MOCKED_SteamAPI_ISteamFriends_GetPersonaName
+S_API const char* SteamAPI_ISteamFriends_GetPersonaName(ISteamFriends* self) {
+	(void)self;
+	return "caulk";
+}
+
+#define MOCKED_SteamAPI_ISteamFriends_GetFriendCount
+S_API int SteamAPI_ISteamFriends_GetFriendCount(ISteamFriends* self, int iFriendFlags) {
+	(void)self, (void)iFriendFlags;
+	return num_friends;
+}
+
+#define MOCKED_SteamAPI_ISteamFriends_GetFriendByIndex
+S_API uint64_steamid SteamAPI_ISteamFriends_GetFriendByIndex(ISteamFriends* self, int iFriend, int iFriendFlags) {
+	(void)self, (void)iFriendFlags;
+	return iFriend >= 0 && iFriend < num_friends ? MOCK_STEAM_ID + 1 + (uint64_steamid)iFriend : 0;
+}
+
+static bool is_friend(uint64_steamid id) {
+	return id > MOCK_STEAM_ID && id <= MOCK_STEAM_ID + (uint64_steamid)num_friends;
+}
+
+#define MOCKED_SteamAPI_ISteamFriends_HasFriend
+S_API bool SteamAPI_ISteamFriends_HasFriend(ISteamFriends* self, uint64_steamid steamIDFriend, int iFriendFlags) {
+	(void)self, (void)iFriendFlags;
+	return is_friend(steamIDFriend);
+}
+
+#define MOCKED_SteamAPI_ISteamFriends_GetFriendPersonaName
+S_API const char* SteamAPI_ISteamFriends_GetFriendPersonaName(ISteamFriends* self, uint64_steamid steamIDFriend) {
+	(void)self;
+	return is_friend(steamIDFriend) ? "friend" : "";
+}
+
+// Every lobby has `num_lobby_keys` keys, `key0` and up, each set to the lobby's ID.
+#define MOCKED_SteamAPI_ISteamMatchmaking_GetLobbyDataCount
+S_API int SteamAPI_ISteamMatchmaking_GetLobbyDataCount(ISteamMatchmaking* self, uint64_steamid steamIDLobby) {
+	(void)self, (void)steamIDLobby;
+	return num_lobby_keys;
+}
+
+#define MOCKED_SteamAPI_ISteamMatchmaking_GetLobbyDataByIndex
+S_API bool SteamAPI_ISteamMatchmaking_GetLobbyDataByIndex(ISteamMatchmaking* self, uint64_steamid steamIDLobby,
+	int iLobbyData, char* pchKey, int cchKeyBufferSize, char* pchValue, int cchValueBufferSize) {
+	(void)self;
+	if (iLobbyData < 0 || iLobbyData >= num_lobby_keys)
+		return false;
+	snprintf(pchKey, (size_t)cchKeyBufferSize, "key%d", iLobbyData);
+	snprintf(pchValue, (size_t)cchValueBufferSize, "%llu", (unsigned long long)steamIDLobby);
+	return true;
+}
+
+#define MOCKED_SteamAPI_ISteamMatchmaking_GetLobbyData
+S_API const char* SteamAPI_ISteamMatchmaking_GetLobbyData(ISteamMatchmaking* self, uint64_steamid steamIDLobby,
+	const char* pchKey) {
+	(void)self;
+	static char value[32];
+	int key;
+	if (sscanf(pchKey, "key%d", &key) != 1 || key < 0 || key >= num_lobby_keys)
+		return "";
+	snprintf(value, sizeof(value), "%llu", (unsigned long long)steamIDLobby);
+	return value;
+}
+
+// Made-up but repeatable action states, so results read one way can be checked against another.
+#define MOCKED_SteamAPI_ISteamInput_RunFrame
+S_API void SteamAPI_ISteamInput_RunFrame(ISteamInput* self, bool bReservedValue) {
+	(void)self, (void)bReservedValue;
+}
+
+#define MOCKED_SteamAPI_ISteamInput_GetDigitalActionData
+S_API InputDigitalActionData_t SteamAPI_ISteamInput_GetDigitalActionData(ISteamInput* self,
+	InputHandle_t inputHandle, InputDigitalActionHandle_t digitalActionHandle) {
+	(void)self;
+	InputDigitalActionData_t data = {};
+	data.bState = ((inputHandle + digitalActionHandle) & 1) != 0;
+	data.bActive = true;
+	return data;
+}
+
+#define MOCKED_SteamAPI_ISteamInput_GetAnalogActionData
+S_API InputAnalogActionData_t SteamAPI_ISteamInput_GetAnalogActionData(ISteamInput* self, InputHandle_t inputHandle,
+	InputAnalogActionHandle_t analogActionHandle) {
+	(void)self;
+	InputAnalogActionData_t data = {};
+	data.x = (float)inputHandle, data.y = (float)analogActionHandle;
+	data.bActive = true;
+	return data;
+}
+
+// Every stat exists and starts at 0. Storing confirms with a `UserStatsStored_t` carrying `store_result` on the next
+// frame, unless that's 0.
+static bool get_stat(const char* name, void* out) {
+	std::lock_guard<std::mutex> guard(lock);
+	auto iter = user_stats.find(name);
+	uint32_t value = iter == user_stats.end() ? 0 : iter->second;
+	memcpy(out, &value, sizeof(value));
+	return true;
+}
+
+static bool set_stat(const char* name, const void* value) {
+	std::lock_guard<std::mutex> guard(lock);
+	memcpy(&user_stats[name], value, sizeof(uint32_t));
+	return true;
+}
+
+#define MOCKED_SteamAPI_ISteamUserStats_GetStatInt32
+S_API bool SteamAPI_ISteamUserStats_GetStatInt32(ISteamUserStats* self, const char* pchName, int32* pData) {
+	(void)self;
+	return get_stat(pchName, pData);
+}
+
+#define MOCKED_SteamAPI_ISteamUserStats_GetStatFloat
+S_API bool SteamAPI_ISteamUserStats_GetStatFloat(ISteamUserStats* self, const char* pchName, float* pData) {
+	(void)self;
+	return get_stat(pchName, pData);
+}
+
+#define MOCKED_SteamAPI_ISteamUserStats_GetAchievement
+S_API bool SteamAPI_ISteamUserStats_GetAchievement(ISteamUserStats* self, const char* pchName, bool* pbAchieved) {
+	(void)self;
+	uint32_t value;
+	get_stat(pchName, &value);
+	*pbAchieved = value != 0;
+	return true;
+}
+
+#define MOCKED_SteamAPI_ISteamUserStats_SetStatInt32
+S_API bool SteamAPI_ISteamUserStats_SetStatInt32(ISteamUserStats* self, const char* pchName, int32 nData) {
+	(void)self;
+	return set_stat(pchName, &nData);
+}
+
+#define MOCKED_SteamAPI_ISteamUserStats_SetStatFloat
+S_API bool SteamAPI_ISteamUserStats_SetStatFloat(ISteamUserStats* self, const char* pchName, float fData) {
+	(void)self;
+	return set_stat(pchName, &fData);
+}
+
+#define MOCKED_SteamAPI_ISteamUserStats_SetAchievement
+S_API bool SteamAPI_ISteamUserStats_SetAchievement(ISteamUserStats* self, const char* pchName) {
+	(void)self;
+	const uint32_t achieved = 1;
+	return set_stat(pchName, &achieved);
+}
+
+#define MOCKED_SteamAPI_ISteamUserStats_StoreStats
+S_API bool SteamAPI_ISteamUserStats_StoreStats(ISteamUserStats* self) {
+	(void)self;
+	std::lock_guard<std::mutex> guard(lock);
+	stores++;
+	if (!store_result)
+		return true;
+
+	UserStatsStored_t stored = {};
+	stored.m_eResult = (EResult)store_result;
+	push_message(&incoming, UserStatsStored_t::k_iCallback, &stored, sizeof(stored));
+	return true;
+}
+
+#define MOCKED_SteamAPI_ISteamUser_GetSteamID
+S_API uint64_steamid SteamAPI_ISteamUser_GetSteamID(ISteamUser* self) {
+	(void)self;
+	return MOCK_STEAM_ID;
+}
+
+#include "__mock.inl"
@@ -0,0 +1,80 @@
+// This is free and unencumbered software released into the public domain.
+//
+// Anyone is free to copy, modify, publish, use, compile, sell, or
+// distribute this software, either in source code form or as a compiled
+// binary, for any purpose, commercial or non-commercial, and by any
+// means.
+//
+// In jurisdictions that recognize copyright laws, the author or authors
+// of this software dedicate any and all copyright interest in the
+// software to the public domain. We make this dedication for the benefit
+// of the public at large and to the detriment of our heirs and
+// successors. We intend this dedication to be an overt act of
+// relinquishment in perpetuity of all present and future rights to this
+// software under copyright law.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+// EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+// MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+// IN NO EVENT SHALL THE AUTHORS BE LIABLE FOR ANY CLAIM, DAMAGES OR
+// OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE,
+// ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR
+// OTHER DEALINGS IN THE SOFTWARE.
+//
+// For more information, please refer to <https://unlicense.org>
+
+// Controls for the mock Steam backend (`caulkMock`), a stand-in for the real shared library that needs no Steam client.
+// Nothing posted here is visible before the next `SteamAPI_ManualDispatch_RunFrame()`, which `caulk_Dispatch()` runs.
+
+#pragma once
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#ifdef _WIN32
+#ifdef CAULK_MOCK_EXPORTS
+#define CAULK_MOCK_API __declspec(dllexport)
+#else
+#define CAULK_MOCK_API __declspec(dllimport)
+#endif
+#else
+#define CAULK_MOCK_API
+#endif
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/// Drops everything queued, pending and streaming, and goes back to no friends, lobby keys or stats.
+CAULK_MOCK_API void caulk_MockReset();
+
+/// Queues one callback.
+CAULK_MOCK_API void caulk_MockPost(int32_t callback, const void* data, uint32_t size);
+
+/// Starts a call that completes `delay_frames` frames after the next one, and returns its `SteamAPICall_t`.
+CAULK_MOCK_API uint64_t caulk_MockCall(int32_t callback, const void* data, uint32_t size, bool io_failed,
+	uint32_t delay_frames);
+
+/// Queues `per_frame` copies of a callback on every frame from now on. A `per_frame` of 0 stops that stream. If `size`
+/// leaves room, each copy starts with its place in the stream, as a `uint64_t` counting up from 0.
+CAULK_MOCK_API void caulk_MockStream(int32_t callback, const void* data, uint32_t size, uint32_t per_frame);
+
+/// Sets how many friends `ISteamFriends` reports. Their names and IDs are made up.
+CAULK_MOCK_API void caulk_MockSetFriends(int count);
+
+/// Sets how many keys every lobby reports. Their names and values are made up.
+CAULK_MOCK_API void caulk_MockSetLobbyKeys(int count);
+
+/// The number of frames run so far.
+CAULK_MOCK_API uint64_t caulk_MockFrames();
+
+/// Sets the `EResult` that `StoreStats()` gets confirmed with (`k_EResultOK` after a reset), or 0 for never.
+CAULK_MOCK_API void caulk_MockSetStoreResult(int result);
+
+/// The number of times `StoreStats()` was called.
+CAULK_MOCK_API uint64_t caulk_MockStores();
+
+#ifdef __cplusplus
+}
+#endif
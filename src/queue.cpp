@@ -0,0 +1,228 @@
+// This is free and unencumbered software released into the public domain.
+//
+// Anyone is free to copy, modify, publish, use, compile, sell, or
+// distribute this software, either in source code form or as a compiled
+// binary, for any purpose, commercial or non-commercial, and by any
+// means.
+//
+// In jurisdictions that recognize copyright laws, the author or authors
+// of this software dedicate any and all copyright interest in the
+// software to the public domain. We make this dedication for the benefit
+// of the public at large and to the detriment of our heirs and
+// successors. We intend this dedication to be an overt act of
+// relinquishment in perpetuity of all present and future rights to this
+// software under copyright law.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+// EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+// MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+// IN NO EVENT SHALL THE AUTHORS BE LIABLE FOR ANY CLAIM, DAMAGES OR
+// OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE,
+// ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR
+// OTHER DEALINGS IN THE SOFTWARE.
+//
+// For more information, please refer to <https://unlicense.org>
+
+#include <atomic>
+#include <thread>
+
+#include "internal.h"
+
+extern "C" {
+// Threaded mode: a pump thread owns the pipe and copies everything into a single-producer/single-consumer ring, which
+// `caulk_Dispatch()` pops on the caller's thread. Records never wrap around the end; the leftover space is skipped.
+enum {
+	queuedCallback,
+	queuedResult,
+	queuedFailedResult, // a result too big for the ring, which arrives as failed and without its payload
+	queuedWrap,
+};
+
+typedef struct {
+	SteamAPICall_t call;
+	int32_t callback;
+	uint32_t size;
+	uint8_t kind;
+	bool io_failed;
+} QueuedHeader;
+
+#define QUEUED_SIZE(size) (sizeof(QueuedHeader) + PADDED(size))
+
+static size_t payload_size(const QueuedHeader* record) {
+	return record->kind == queuedFailedResult ? 0 : record->size;
+}
+
+static uint8_t* queue = NULL;
+static std::atomic<size_t> queue_head(0), queue_tail(0), queue_count(0), dropped_count(0);
+static std::atomic<bool> pump_running(false);
+static std::thread pump_thread;
+
+// Returns where the next record of `size` payload bytes goes, or `NULL` if the pump was told to stop while waiting for
+// room. Nothing is visible to the consumer until `publish_record()`.
+static QueuedHeader* reserve_record(size_t size, size_t* out_head) {
+	const size_t need = QUEUED_SIZE(size);
+	if (need > caulk_config.queue_size)
+		return NULL; // would never fit
+
+	for (;;) {
+		size_t head = queue_head.load(std::memory_order_relaxed);
+		size_t tail = queue_tail.load(std::memory_order_acquire);
+		size_t offset = head % caulk_config.queue_size, skip = caulk_config.queue_size - offset;
+		if (skip >= need)
+			skip = 0;
+
+		if (caulk_config.queue_size - (head - tail) >= skip + need) {
+			if (skip >= sizeof(QueuedHeader))
+				reinterpret_cast<QueuedHeader*>(queue + offset)->kind = queuedWrap;
+			*out_head = head + skip + need;
+			return reinterpret_cast<QueuedHeader*>(queue + (head + skip) % caulk_config.queue_size);
+		}
+
+		if (!pump_running.load(std::memory_order_relaxed))
+			return NULL;
+		std::this_thread::yield();
+	}
+}
+
+static void publish_record(size_t head) {
+	queue_head.store(head, std::memory_order_release);
+	queue_count.fetch_add(1, std::memory_order_release);
+}
+
+// the pump's end of the ring; only ever touched from the pump thread
+static size_t pending_result_head = 0;
+
+static void* queue_result_buffer(Sink* sink, size_t size) {
+	(void)sink;
+	QueuedHeader* record = reserve_record(size, &pending_result_head);
+	return record ? record + 1 : NULL;
+}
+
+static void queue_result(Sink* sink, SteamAPICall_t call, int32_t callback, void* data, uint32_t size,
+	bool io_failed) {
+	(void)sink;
+	if (data) {
+		QueuedHeader* record = reinterpret_cast<QueuedHeader*>(data) - 1;
+		*record = {call, callback, size, queuedResult, io_failed};
+		publish_record(pending_result_head);
+		return;
+	}
+
+	// its handler still has to hear about it, or it would wait forever
+	size_t head;
+	QueuedHeader* record = reserve_record(0, &head);
+	if (!record)
+		return;
+	*record = {call, callback, size, queuedFailedResult, true};
+	publish_record(head);
+	dropped_count.fetch_add(1, std::memory_order_relaxed);
+}
+
+static void queue_callback(Sink* sink, int32_t callback, void* data, uint32_t size) {
+	(void)sink;
+	if (QUEUED_SIZE(size) > caulk_config.queue_size) {
+		dropped_count.fetch_add(1, std::memory_order_relaxed);
+		return;
+	}
+
+	size_t head;
+	QueuedHeader* record = reserve_record(size, &head);
+	if (!record)
+		return;
+
+	*record = {k_uAPICallInvalid, callback, size, queuedCallback, false};
+	memcpy(record + 1, data, size);
+	publish_record(head);
+}
+
+static Sink queue_sink = {caulk_handlers_fit, queue_result_buffer, queue_result, queue_callback};
+
+static void pump() {
+	HSteamPipe steam_pipe = SteamAPI_GetHSteamPipe();
+
+	while (pump_running.load(std::memory_order_relaxed)) {
+		caulk_run_frame(steam_pipe);
+
+		CallbackMsg_t callback;
+		while (SteamAPI_ManualDispatch_GetNextCallback(steam_pipe, &callback)) {
+			caulk_dispatch_message(&queue_sink, steam_pipe, &callback);
+			SteamAPI_ManualDispatch_FreeLastCallback(steam_pipe);
+		}
+
+		std::this_thread::sleep_for(std::chrono::microseconds(caulk_config.pump_interval_us));
+	}
+}
+
+bool caulk_start_pump() {
+	queue = (uint8_t*)caulk_config.alloc(caulk_config.queue_size, caulk_config.userdata);
+	if (!queue)
+		return false;
+	queue_head = queue_tail = queue_count = dropped_count = 0;
+
+	pump_running = true;
+	try {
+		pump_thread = std::thread(pump);
+	} catch (...) {
+		pump_running = false;
+		caulk_config.dealloc(queue, caulk_config.userdata), queue = NULL;
+		return false;
+	}
+	return true;
+}
+
+void caulk_stop_pump() {
+	if (!queue)
+		return;
+
+	pump_running = false;
+	if (pump_thread.joinable())
+		pump_thread.join();
+	caulk_config.dealloc(queue, caulk_config.userdata), queue = NULL;
+}
+
+bool caulk_dispatch_queue(Sink* sink, uint32_t max_us, size_t max_callbacks) {
+	const auto start = std::chrono::steady_clock::now();
+
+	for (size_t dispatched = 0;;) {
+		size_t tail = queue_tail.load(std::memory_order_relaxed);
+		if (tail == queue_head.load(std::memory_order_acquire))
+			break;
+
+		size_t offset = tail % caulk_config.queue_size, left = caulk_config.queue_size - offset;
+		QueuedHeader* record = reinterpret_cast<QueuedHeader*>(queue + offset);
+		if (left < sizeof(QueuedHeader) || record->kind == queuedWrap) {
+			queue_tail.store(tail + left, std::memory_order_release);
+			continue;
+		}
+
+		if (caulk_over_budget(start, max_us, max_callbacks, dispatched)
+			|| !sink->fits(sink, 1, PADDED(payload_size(record))))
+			break;
+
+		if (record->kind == queuedCallback)
+			sink->callback(sink, record->callback, record + 1, record->size);
+		else {
+			void* data = record->kind == queuedResult ? record + 1 : NULL;
+			sink->result(sink, record->call, record->callback, data, record->size, record->io_failed);
+		}
+
+		queue_count.fetch_sub(1, std::memory_order_relaxed);
+		queue_tail.store(tail + QUEUED_SIZE(payload_size(record)), std::memory_order_release);
+		dispatched++;
+	}
+
+	return queue_count.load(std::memory_order_acquire) != 0;
+}
+
+bool caulk_pumping() {
+	return queue != NULL;
+}
+
+size_t caulk_QueuedMessages() {
+	return queue ? queue_count.load(std::memory_order_acquire) : 0;
+}
+
+size_t caulk_DroppedMessages() {
+	return dropped_count.load(std::memory_order_relaxed);
+}
+}
@@ -0,0 +1,279 @@
+// This is free and unencumbered software released into the public domain.
+//
+// Anyone is free to copy, modify, publish, use, compile, sell, or
+// distribute this software, either in source code form or as a compiled
+// binary, for any purpose, commercial or non-commercial, and by any
+// means.
+//
+// In jurisdictions that recognize copyright laws, the author or authors
+// of this software dedicate any and all copyright interest in the
+// software to the public domain. We make this dedication for the benefit
+// of the public at large and to the detriment of our heirs and
+// successors. We intend this dedication to be an overt act of
+// relinquishment in perpetuity of all present and future rights to this
+// software under copyright law.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+// EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+// MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+// IN NO EVENT SHALL THE AUTHORS BE LIABLE FOR ANY CLAIM, DAMAGES OR
+// OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE,
+// ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR
+// OTHER DEALINGS IN THE SOFTWARE.
+//
+// For more information, please refer to <https://unlicense.org>
+
+#include "internal.h"
+
+extern "C" {
+// Stats and achievements are written behind: setters only change `values`, and whatever differs from what Steam last
+// confirmed goes out in one `StoreStats()` per interval, retried with a backoff if it doesn't stick.
+#define STATS_RETRY_MS (1000)
+// the mocked builds wait less, so that caulkTest can see a store time out
+#ifndef CAULK_STATS_STORE_TIMEOUT_MS
+#define CAULK_STATS_STORE_TIMEOUT_MS (30 * 1000)
+#endif
+
+typedef struct {
+	size_t count, capacity;
+	char** names;
+	caulk_StatKind* kinds;
+	uint32_t *values, *stored, *sent; // raw bits, so a float compares equal only to itself
+
+	bool dirty, store_requested, storing;
+	uint64_t next_store, store_deadline;
+	uint32_t retry_ms;
+} UserStats;
+
+static UserStats user_stats = {};
+
+static bool read_stat(size_t idx, uint32_t* out) {
+	ISteamUserStats* iface = caulk_gSteamUserStats;
+	const char* name = user_stats.names[idx];
+	switch (user_stats.kinds[idx]) {
+	case caulk_StatInt32:
+		return SteamAPI_ISteamUserStats_GetStatInt32(iface, name, (int32*)out);
+	case caulk_StatFloat:
+		return SteamAPI_ISteamUserStats_GetStatFloat(iface, name, (float*)out);
+	default: {
+		bool achieved;
+		if (!SteamAPI_ISteamUserStats_GetAchievement(iface, name, &achieved))
+			return false;
+		*out = achieved;
+		return true;
+	}
+	}
+}
+
+static bool write_stat(size_t idx) {
+	ISteamUserStats* iface = caulk_gSteamUserStats;
+	const char* name = user_stats.names[idx];
+	uint32_t value = user_stats.values[idx];
+	switch (user_stats.kinds[idx]) {
+	case caulk_StatInt32:
+		return SteamAPI_ISteamUserStats_SetStatInt32(iface, name, (int32)value);
+	case caulk_StatFloat: {
+		float data;
+		memcpy(&data, &value, sizeof(data));
+		return SteamAPI_ISteamUserStats_SetStatFloat(iface, name, data);
+	}
+	default:
+		return SteamAPI_ISteamUserStats_SetAchievement(iface, name);
+	}
+}
+
+// Takes Steam's values for every stat nobody has changed since it was last stored.
+static void reload_user_stats() {
+	for (size_t idx = 0; idx < user_stats.count; idx++) {
+		uint32_t value;
+		if (!read_stat(idx, &value))
+			continue;
+		if (user_stats.values[idx] == user_stats.stored[idx])
+			user_stats.values[idx] = value;
+		user_stats.stored[idx] = value;
+	}
+
+	user_stats.dirty = false;
+	for (size_t idx = 0; idx < user_stats.count; idx++)
+		user_stats.dirty |= user_stats.values[idx] != user_stats.stored[idx];
+}
+
+static void retry_user_stats(uint64_t now) {
+	user_stats.storing = false;
+	user_stats.retry_ms = user_stats.retry_ms ? user_stats.retry_ms * 2 : STATS_RETRY_MS;
+	if (user_stats.retry_ms > caulk_config.stats_store_interval_ms)
+		user_stats.retry_ms = caulk_config.stats_store_interval_ms;
+	user_stats.next_store = now + user_stats.retry_ms;
+}
+
+static void on_user_stats_received(void* data, void* ctx) {
+	(void)ctx;
+	const UserStatsReceived_t* received = reinterpret_cast<const UserStatsReceived_t*>(data);
+	if (received->m_eResult == k_EResultOK
+		&& received->m_steamIDUser.ConvertToUint64() == SteamAPI_ISteamUser_GetSteamID(caulk_gSteamUser))
+		reload_user_stats();
+}
+
+static void on_user_stats_stored(void* data, void* ctx) {
+	(void)ctx;
+	const UserStatsStored_t* result = reinterpret_cast<const UserStatsStored_t*>(data);
+	if (!user_stats.storing)
+		return;
+
+	if (result->m_eResult == k_EResultOK) {
+		memcpy(user_stats.stored, user_stats.sent, user_stats.count * sizeof(uint32_t));
+		user_stats.storing = false, user_stats.retry_ms = 0;
+		user_stats.dirty = memcmp(user_stats.values, user_stats.stored, user_stats.count * sizeof(uint32_t));
+	} else if (result->m_eResult == k_EResultInvalidParam) {
+		// Steam refused some of them and went back to its own values; sending those again wouldn't help
+		memcpy(user_stats.stored, user_stats.sent, user_stats.count * sizeof(uint32_t));
+		user_stats.storing = false;
+		reload_user_stats();
+	} else
+		retry_user_stats(caulk_current_tick());
+}
+
+void caulk_store_user_stats() {
+	if (!user_stats.dirty && !user_stats.storing) {
+		user_stats.store_requested = false;
+		return;
+	}
+
+	const uint64_t now = caulk_current_tick();
+	if (user_stats.storing) {
+		if (now >= user_stats.store_deadline)
+			retry_user_stats(now);
+		return;
+	}
+	if (!user_stats.store_requested && now < user_stats.next_store)
+		return;
+
+	bool changed = false, written = false;
+	for (size_t idx = 0; idx < user_stats.count; idx++) {
+		user_stats.sent[idx] = user_stats.stored[idx];
+		if (user_stats.values[idx] == user_stats.stored[idx])
+			continue;
+		changed = true;
+		if (write_stat(idx))
+			user_stats.sent[idx] = user_stats.values[idx], written = true;
+	}
+
+	user_stats.store_requested = false;
+	if (!changed) {
+		user_stats.dirty = false; // everything was set back to what's stored
+		return;
+	}
+	if (!written || !SteamAPI_ISteamUserStats_StoreStats(caulk_gSteamUserStats)) {
+		retry_user_stats(now);
+		return;
+	}
+	user_stats.storing = true, user_stats.store_deadline = now + CAULK_STATS_STORE_TIMEOUT_MS;
+	user_stats.next_store = now + caulk_config.stats_store_interval_ms;
+}
+
+static bool grow_user_stats() {
+	size_t old = user_stats.capacity, capacity = old ? old * 2 : 32;
+	if (!caulk_grow_array(&user_stats.names, sizeof(char*), old, capacity)
+		|| !caulk_grow_array(&user_stats.kinds, sizeof(caulk_StatKind), old, capacity)
+		|| !caulk_grow_array(&user_stats.values, sizeof(uint32_t), old, capacity)
+		|| !caulk_grow_array(&user_stats.stored, sizeof(uint32_t), old, capacity)
+		|| !caulk_grow_array(&user_stats.sent, sizeof(uint32_t), old, capacity))
+		return false;
+	user_stats.capacity = capacity;
+	return true;
+}
+
+void caulk_free_user_stats() {
+	for (size_t idx = 0; idx < user_stats.count; idx++)
+		caulk_config.dealloc(user_stats.names[idx], caulk_config.userdata);
+
+	void* arrays[] = {user_stats.names, user_stats.kinds, user_stats.values, user_stats.stored, user_stats.sent};
+	for (size_t idx = 0; idx < LENGTH(arrays); idx++)
+		if (arrays[idx])
+			caulk_config.dealloc(arrays[idx], caulk_config.userdata);
+	user_stats = {};
+}
+
+caulk_Stat caulk_RegisterStat(const char* name, caulk_StatKind kind) {
+	if (!caulk_initialized() || !name || (unsigned)kind > caulk_StatAchievement)
+		return 0;
+
+	for (size_t idx = 0; idx < user_stats.count; idx++)
+		if (!strcmp(user_stats.names[idx], name))
+			return user_stats.kinds[idx] == kind ? (caulk_Stat)idx + 1 : 0;
+
+	if (!user_stats.capacity) {
+		if (!caulk_subscribe(UserStatsReceived_t_iCallback, on_user_stats_received, NULL)
+			|| !caulk_subscribe(UserStatsStored_t_iCallback, on_user_stats_stored, NULL))
+			return 0;
+		user_stats.next_store = caulk_current_tick() + caulk_config.stats_store_interval_ms;
+	}
+	if (user_stats.count == user_stats.capacity && !grow_user_stats())
+		return 0;
+
+	size_t size = strlen(name) + 1, idx = user_stats.count;
+	char* copy = (char*)caulk_config.alloc(size, caulk_config.userdata);
+	if (!copy)
+		return 0;
+	memcpy(copy, name, size);
+
+	// stats Steam hasn't sent yet start at 0, and get filled in by `UserStatsReceived_t`
+	user_stats.names[idx] = copy, user_stats.kinds[idx] = kind;
+	user_stats.count++;
+	uint32_t value = 0;
+	read_stat(idx, &value);
+	user_stats.values[idx] = user_stats.stored[idx] = value;
+	return (caulk_Stat)user_stats.count;
+}
+
+static uint32_t* stat_value(caulk_Stat stat, caulk_StatKind kind) {
+	if (!stat || stat > user_stats.count || user_stats.kinds[stat - 1] != kind)
+		return NULL;
+	return &user_stats.values[stat - 1];
+}
+
+static bool set_stat(caulk_Stat stat, caulk_StatKind kind, uint32_t value) {
+	uint32_t* slot = stat_value(stat, kind);
+	if (!slot)
+		return false;
+	*slot = value;
+	user_stats.dirty |= value != user_stats.stored[stat - 1];
+	return true;
+}
+
+bool caulk_SetStatInt32(caulk_Stat stat, int32_t value) {
+	return set_stat(stat, caulk_StatInt32, (uint32_t)value);
+}
+
+bool caulk_SetStatFloat(caulk_Stat stat, float value) {
+	uint32_t bits;
+	memcpy(&bits, &value, sizeof(bits));
+	return set_stat(stat, caulk_StatFloat, bits);
+}
+
+bool caulk_SetAchievement(caulk_Stat stat) {
+	return set_stat(stat, caulk_StatAchievement, 1);
+}
+
+int32_t caulk_GetStatInt32(caulk_Stat stat) {
+	uint32_t* slot = stat_value(stat, caulk_StatInt32);
+	return slot ? (int32_t)*slot : 0;
+}
+
+float caulk_GetStatFloat(caulk_Stat stat) {
+	uint32_t* slot = stat_value(stat, caulk_StatFloat);
+	float value = 0;
+	if (slot)
+		memcpy(&value, slot, sizeof(value));
+	return value;
+}
+
+bool caulk_GetAchievement(caulk_Stat stat) {
+	uint32_t* slot = stat_value(stat, caulk_StatAchievement);
+	return slot && *slot;
+}
+
+void caulk_StoreStats() {
+	user_stats.store_requested = true;
+}
+}
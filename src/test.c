@@ -23,19 +23,664 @@
 //
 // For more information, please refer to <https://unlicense.org>
 
+// The code example doubles as caulk's test: it runs against the mock Steam backend (see `mock.h`), checks the parts of
+// dispatching that are easy to get subtly wrong, then shows off the basics.
+
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
 
 #include <caulk.h>
 
+#include "mock.h"
+
 #ifdef _WIN32
 #include <windows.h>
-#define sleep_secs(s) (Sleep((s) * 1000))
+#define sleep_ms(ms) (Sleep((ms)))
 #else
 #include <unistd.h>
-#define sleep_secs(s) (sleep(s))
+#define sleep_ms(ms) (usleep((ms) * 1000))
 #endif
 
+#define LENGTH(expr) (sizeof((expr)) / sizeof(*(expr)))
+
+// Bails out of the check it's in, saying which line failed.
+#define CHECK(expr) do { if (!(expr)) return check_failed(#expr, __LINE__); } while (0)
+
+static bool check_failed(const char* expr, int line) {
+	fprintf(stderr, "%s:%d: CHECK(%s) failed\n", __FILE__, line, expr);
+	return false;
+}
+
+// callback IDs that Steam doesn't use, so nothing in caulk treats them specially
+#define TEST_CALLBACK (100000)
+#define TEST_RESULT (100001)
+
+typedef struct {
+	uint64_t sequence;
+	uint64_t padding[2];
+} Message;
+
+static void post(uint64_t sequence) {
+	Message message = {sequence, {0, 0}};
+	caulk_MockPost(TEST_CALLBACK, &message, sizeof(message));
+}
+
+static void on_counted(void* data, void* ctx) {
+	(void)data;
+	(*(int*)ctx)++;
+}
+
+static int unsubscribe_calls[4];
+static caulk_Handle unsubscribe_handles[4];
+
+// Unregisters the next subscriber in line, and then itself.
+static void on_unsubscribing(void* data) {
+	(void)data;
+	unsubscribe_calls[0]++;
+	caulk_Unregister(unsubscribe_handles[1]);
+	caulk_Unregister(unsubscribe_handles[0]);
+}
+
+static bool check_unregister_during_dispatch() {
+	memset(unsubscribe_calls, 0, sizeof(unsubscribe_calls));
+	unsubscribe_handles[0] = caulk_Register(TEST_CALLBACK, on_unsubscribing);
+	for (int i = 1; i < 3; i++)
+		unsubscribe_handles[i] = caulk_RegisterCtx(TEST_CALLBACK, on_counted, &unsubscribe_calls[i]);
+
+	post(0);
+	caulk_Dispatch();
+	CHECK(unsubscribe_calls[0] == 1 && unsubscribe_calls[1] == 0 && unsubscribe_calls[2] == 1);
+	CHECK(!caulk_Unregister(unsubscribe_handles[0]) && !caulk_Unregister(unsubscribe_handles[1]));
+
+	// the list got compacted after that dispatch, so the survivor's handle has to point at where it moved
+	unsubscribe_handles[3] = caulk_RegisterCtx(TEST_CALLBACK, on_counted, &unsubscribe_calls[3]);
+	post(1);
+	caulk_Dispatch();
+	CHECK(unsubscribe_calls[0] == 1 && unsubscribe_calls[2] == 2 && unsubscribe_calls[3] == 1);
+
+	CHECK(caulk_Unregister(unsubscribe_handles[2]));
+	post(2);
+	caulk_Dispatch();
+	CHECK(unsubscribe_calls[2] == 2 && unsubscribe_calls[3] == 2);
+	return true;
+}
+
+static bool check_stale_handle() {
+	int first = 0, second = 0;
+	caulk_Handle stale = caulk_RegisterCtx(TEST_CALLBACK, on_counted, &first);
+	CHECK(stale && caulk_Unregister(stale));
+
+	// reuses the slot `stale` had, under a new generation
+	caulk_Handle handle = caulk_RegisterCtx(TEST_CALLBACK, on_counted, &second);
+	CHECK(handle && handle != stale);
+	CHECK(!caulk_Unregister(stale));
+
+	post(0);
+	caulk_Dispatch();
+	CHECK(first == 0 && second == 1);
+	CHECK(caulk_Unregister(handle) && !caulk_Unregister(handle));
+	return true;
+}
+
+typedef struct {
+	uint64_t seen[8];
+	size_t count;
+} Sequence;
+
+static void on_sequenced(void* data, void* ctx) {
+	Sequence* sequence = (Sequence*)ctx;
+	if (sequence->count < LENGTH(sequence->seen))
+		sequence->seen[sequence->count] = ((const Message*)data)->sequence;
+	sequence->count++;
+}
+
+static bool check_budget_hold() {
+	Sequence sequence = {{0}, 0};
+	caulk_RegisterCtx(TEST_CALLBACK, on_sequenced, &sequence);
+	for (uint64_t i = 0; i < 3; i++)
+		post(i);
+
+	uint64_t frames = caulk_MockFrames();
+	CHECK(caulk_DispatchBudget(0, 1));
+	CHECK(sequence.count == 1 && sequence.seen[0] == 0);
+
+	// the held callback goes first, and holding one doesn't keep Steam's frames from running
+	post(3);
+	CHECK(caulk_DispatchBudget(0, 1));
+	CHECK(sequence.count == 2 && sequence.seen[1] == 1);
+	CHECK(caulk_MockFrames() == frames + 2);
+
+	CHECK(!caulk_DispatchBudget(0, 0));
+	CHECK(sequence.count == 4 && sequence.seen[2] == 2 && sequence.seen[3] == 3);
+	CHECK(caulk_QueuedMessages() == 0);
+	return true;
+}
+
+static bool check_dispatch_into() {
+	static const uint8_t result[16] = {42};
+	SteamAPICall_t call = caulk_MockCall(TEST_RESULT, result, sizeof(result), true, 0);
+	for (uint64_t i = 0; i < 4; i++)
+		post(i);
+
+	caulk_Event events[8];
+	uint64_t arena[64];
+
+	// room for two payloads only
+	CHECK(caulk_DispatchInto(events, LENGTH(events), arena, 2 * sizeof(Message)) == 2);
+	for (uint64_t i = 0; i < 2; i++) {
+		CHECK(events[i].callback == TEST_CALLBACK && events[i].size == sizeof(Message));
+		CHECK(((const Message*)events[i].data)->sequence == i);
+	}
+
+	// room for one event only
+	CHECK(caulk_DispatchInto(events, 1, arena, sizeof(arena)) == 1);
+	CHECK(((const Message*)events[0].data)->sequence == 2);
+
+	// a completed call takes two events, so it waits for a batch with room for both
+	CHECK(caulk_DispatchInto(events, 2, arena, sizeof(arena)) == 1);
+	CHECK(((const Message*)events[0].data)->sequence == 3);
+	CHECK(caulk_DispatchInto(events, 2, arena, sizeof(arena)) == 2);
+	CHECK(events[0].call == call && events[0].callback == TEST_RESULT && events[0].io_failed);
+	CHECK(events[0].size == sizeof(result) && !memcmp(events[0].data, result, sizeof(result)));
+	CHECK(events[1].callback == SteamAPICallCompleted_t_iCallback);
+	CHECK(caulk_DispatchInto(events, LENGTH(events), arena, sizeof(arena)) == 0);
+
+	// a payload that could never fit still goes out, without its data but with the size it needs
+	post(4);
+	CHECK(caulk_DispatchInto(events, LENGTH(events), arena, sizeof(uint64_t)) == 1);
+	CHECK(events[0].callback == TEST_CALLBACK && !events[0].data && events[0].size == sizeof(Message));
+
+	// and with room for just one event, a completed call only brings its result
+	call = caulk_MockCall(TEST_RESULT, result, sizeof(result), false, 0);
+	CHECK(caulk_DispatchInto(events, 1, arena, sizeof(arena)) == 1);
+	CHECK(events[0].call == call && !events[0].io_failed && !memcmp(events[0].data, result, sizeof(result)));
+	CHECK(caulk_DispatchInto(events, LENGTH(events), arena, sizeof(arena)) == 0);
+	return true;
+}
+
+#define TEST_FRIEND (76561197960265729ull) // the first of the mock's friends
+
+static void post_persona_change(uint64_t id, int flags) {
+	PersonaStateChange_t change = {0};
+	change.m_ulSteamID = id;
+	change.m_nChangeFlags = flags;
+	caulk_MockPost(PersonaStateChange_t_iCallback, &change, sizeof(change));
+}
+
+typedef struct {
+	uint64_t ids[8];
+	int flags[8];
+	size_t count;
+} PersonaChanges;
+
+static void on_persona_change(PersonaStateChange_t* data, void* ctx) {
+	PersonaChanges* changes = (PersonaChanges*)ctx;
+	if (changes->count < LENGTH(changes->ids)) {
+		changes->ids[changes->count] = data->m_ulSteamID;
+		changes->flags[changes->count] = data->m_nChangeFlags;
+	}
+	changes->count++;
+}
+
+static bool check_coalesce() {
+	PersonaChanges changes = {{0}, {0}, 0};
+	CHECK(caulk_Coalesce(PersonaStateChange_t_iCallback, true));
+	CHECK(!caulk_Coalesce(TEST_CALLBACK, true)); // nothing to key it by
+	caulk_OnPersonaStateChange(on_persona_change, &changes);
+
+	// one call per friend, in the order they first came in, with their flags ORed together
+	post_persona_change(TEST_FRIEND, k_EPersonaChangeName);
+	post_persona_change(TEST_FRIEND + 1, k_EPersonaChangeStatus);
+	post_persona_change(TEST_FRIEND, k_EPersonaChangeGamePlayed);
+	caulk_Dispatch();
+	CHECK(changes.count == 2 && changes.ids[0] == TEST_FRIEND && changes.ids[1] == TEST_FRIEND + 1);
+	CHECK(changes.flags[0] == (k_EPersonaChangeName | k_EPersonaChangeGamePlayed));
+	CHECK(changes.flags[1] == k_EPersonaChangeStatus);
+
+	// a payload that grew replaces the one waiting, rather than going out ahead of it
+	changes.count = 0;
+	PersonaStateChange_t short_change = {0};
+	short_change.m_ulSteamID = TEST_FRIEND;
+	caulk_MockPost(PersonaStateChange_t_iCallback, &short_change, sizeof(short_change.m_ulSteamID));
+	post_persona_change(TEST_FRIEND, k_EPersonaChangeName);
+	caulk_Dispatch();
+	CHECK(changes.count == 1 && changes.flags[0] == k_EPersonaChangeName);
+
+	CHECK(caulk_Coalesce(PersonaStateChange_t_iCallback, false));
+	changes.count = 0;
+	post_persona_change(TEST_FRIEND, k_EPersonaChangeName);
+	post_persona_change(TEST_FRIEND, k_EPersonaChangeStatus);
+	caulk_Dispatch();
+	CHECK(changes.count == 2);
+	return true;
+}
+
+static const caulk_Config friends_config = {
+	64, 64, NULL, NULL, NULL, false, 0, 0, 0, 0, k_EFriendFlagImmediate, 0};
+
+static bool check_friends_snapshot() {
+	// the mock has no friends at init, so they all come in through `PersonaStateChange_t`
+	const caulk_FriendsSnapshot* snapshot = caulk_GetFriendsSnapshot();
+	CHECK(snapshot && !snapshot->count);
+	caulk_MockSetFriends(4);
+	for (uint64_t i = 0; i < 4; i++)
+		post_persona_change(TEST_FRIEND + i, k_EPersonaChangeRelationshipChanged);
+	caulk_Dispatch();
+	snapshot = caulk_GetFriendsSnapshot();
+	CHECK(snapshot->count == 4 && snapshot->ids[3] == TEST_FRIEND + 3 && snapshot->name_text[snapshot->names[3]]);
+	CHECK(snapshot->num_dirty == 1 && snapshot->dirty[0].first == 0 && snapshot->dirty[0].count == 4);
+
+	// nothing actually changed
+	caulk_ClearFriendsSnapshotDirty();
+	post_persona_change(TEST_FRIEND + 1, k_EPersonaChangeStatus);
+	caulk_Dispatch();
+	CHECK(!caulk_GetFriendsSnapshot()->num_dirty);
+
+	// Befriends one more, then unfriends the one before it, which moves the new one into its place. A name change
+	// for the moved friend has to land on their new position.
+	const uint64_t added = TEST_FRIEND + 4, removed = added - 1;
+	caulk_MockSetFriends(5);
+	post_persona_change(added, k_EPersonaChangeRelationshipChanged | k_EPersonaChangeName);
+	caulk_Dispatch();
+	snapshot = caulk_GetFriendsSnapshot();
+	CHECK(snapshot->count == 5 && snapshot->ids[4] == added);
+
+	// the mock only knows the first three now, so `added` reads back with an empty name
+	caulk_MockSetFriends(3);
+	post_persona_change(removed, k_EPersonaChangeRelationshipChanged);
+	caulk_Dispatch();
+	caulk_ClearFriendsSnapshotDirty();
+	post_persona_change(added, k_EPersonaChangeName);
+	caulk_Dispatch();
+	snapshot = caulk_GetFriendsSnapshot();
+	CHECK(snapshot->count == 4 && snapshot->ids[3] == added && !snapshot->name_text[snapshot->names[3]]);
+	CHECK(snapshot->num_dirty == 1 && snapshot->dirty[0].first == 3 && snapshot->dirty[0].count == 1);
+
+	// a relationship change that leaves them a friend still carries their new name
+	caulk_MockSetFriends(5);
+	post_persona_change(added, k_EPersonaChangeRelationshipChanged | k_EPersonaChangeName);
+	caulk_Dispatch();
+	snapshot = caulk_GetFriendsSnapshot();
+	CHECK(snapshot->count == 4 && snapshot->name_text[snapshot->names[3]]);
+	return true;
+}
+
+typedef struct {
+	int calls, order;
+	bool null_result, io_failed;
+} Resolved;
+
+static int resolved_order = 0;
+
+static void on_resolved(void* data, bool io_failed, void* ctx) {
+	Resolved* resolved = (Resolved*)ctx;
+	resolved->calls++, resolved->order = resolved_order++;
+	resolved->null_result = data == NULL, resolved->io_failed = io_failed;
+}
+
+static bool check_timeout() {
+	// Steam never hears of these calls, so only the timeouts can end them. 100 ms is past what the wheel's lowest
+	// level spans, so that one has to drop down a level before it fires.
+	Resolved short_wait = {0}, long_wait = {0};
+	resolved_order = 0;
+	caulk_Handle handle = caulk_ResolveWithTimeout(0xC0FFEE, on_resolved, &long_wait, 100);
+	CHECK(handle && caulk_ResolveWithTimeout(0xC0FFEF, on_resolved, &short_wait, 10));
+
+	for (int waited = 0; waited < 2000 && !long_wait.calls; waited += 5) {
+		sleep_ms(5);
+		caulk_Dispatch();
+	}
+
+	CHECK(short_wait.calls == 1 && short_wait.null_result && short_wait.io_failed);
+	CHECK(long_wait.calls == 1 && long_wait.null_result && long_wait.io_failed);
+	CHECK(short_wait.order == 0 && long_wait.order == 1);
+	CHECK(!caulk_Unregister(handle));
+	return true;
+}
+
+static const caulk_Config threaded_config = {64, 64, NULL, NULL, NULL, true, 256, 0, 0, 0, 0, 0};
+
+// Dispatches until `*handled` reaches `count`, giving the pump thread up to two seconds.
+static bool pump_until(const int* handled, int count) {
+	for (int waited = 0; waited < 2000 && *handled < count; waited++) {
+		sleep_ms(1);
+		caulk_Dispatch();
+	}
+	return *handled >= count;
+}
+
+static bool check_queue_oversized() {
+	static const uint8_t big[512] = {0};
+	Resolved resolved = {0};
+	int handled = 0;
+	caulk_RegisterCtx(TEST_CALLBACK, on_counted, &handled);
+	SteamAPICall_t call = caulk_MockCall(TEST_RESULT, big, sizeof(big), false, 0);
+	CHECK(caulk_ResolveCtx(call, on_resolved, &resolved));
+
+	// neither fits a 256-byte queue; the callback is lost, the result still ends its call
+	caulk_MockPost(TEST_CALLBACK, big, sizeof(big));
+	post(0);
+	CHECK(pump_until(&handled, 1) && pump_until(&resolved.calls, 1));
+	CHECK(handled == 1 && resolved.null_result && resolved.io_failed);
+	CHECK(caulk_DroppedMessages() == 2);
+	return true;
+}
+
+// room for only a handful of 16-byte results, which nobody polled for more than three dispatches lose
+static const caulk_Config poll_config = {64, 64, NULL, NULL, NULL, false, 0, 0, 256, 3, 0, 0};
+
+static SteamAPICall_t poll_calls[300];
+
+static SteamAPICall_t complete_call(uint8_t tag) {
+	uint8_t result[16] = {tag};
+	return caulk_MockCall(TEST_RESULT, result, sizeof(result), false, 0);
+}
+
+static bool check_poll_eviction() {
+	for (size_t i = 0; i < 8; i++)
+		poll_calls[i] = complete_call((uint8_t)i);
+	caulk_Dispatch();
+
+	// too small a buffer leaves the result where it is
+	uint8_t out[16];
+	bool io_failed = true;
+	CHECK(caulk_Poll(poll_calls[7], out, 4, &io_failed) == caulk_PollFailed);
+	CHECK(caulk_Poll(poll_calls[7], out, sizeof(out), &io_failed) == caulk_PollReady && out[0] == 7 && !io_failed);
+	CHECK(caulk_Poll(poll_calls[7], out, sizeof(out), &io_failed) == caulk_PollPending);
+
+	// the oldest got pushed out, and saying so once is enough
+	CHECK(caulk_Poll(poll_calls[0], out, sizeof(out), &io_failed) == caulk_PollEvicted);
+	CHECK(caulk_Poll(poll_calls[0], out, sizeof(out), &io_failed) == caulk_PollPending);
+	// the rest go oldest first too: once one is still there, so is everything after it
+	size_t ready = 0;
+	for (size_t i = 1; i < 7; i++) {
+		caulk_PollStatus status = caulk_Poll(poll_calls[i], out, sizeof(out), &io_failed);
+		CHECK(status == caulk_PollReady || (status == caulk_PollEvicted && !ready));
+		CHECK(status == caulk_PollEvicted || out[0] == i);
+		ready += status == caulk_PollReady;
+	}
+	CHECK(ready && ready < 6);
+
+	// and so does going unpolled for `result_cache_frames` dispatches
+	SteamAPICall_t stale = complete_call(0);
+	for (int i = 0; i < 4; i++)
+		caulk_Dispatch();
+	CHECK(caulk_Poll(stale, out, sizeof(out), &io_failed) == caulk_PollEvicted);
+
+	// only the last 256 calls pushed out are remembered, the ones before read as pending
+	for (size_t i = 0; i < LENGTH(poll_calls); i++)
+		poll_calls[i] = complete_call((uint8_t)i);
+	caulk_Dispatch();
+	size_t evicted = 0;
+	for (size_t i = 0; i < LENGTH(poll_calls); i++)
+		evicted += caulk_Poll(poll_calls[i], out, sizeof(out), &io_failed) == caulk_PollEvicted;
+	CHECK(evicted == 256);
+	CHECK(caulk_Poll(poll_calls[0], out, sizeof(out), &io_failed) == caulk_PollPending);
+	return true;
+}
+
+static const caulk_Config stats_config = {64, 64, NULL, NULL, NULL, false, 0, 0, 0, 0, 0, 50};
+
+// Dispatches until the mock has seen `count` stores, giving it up to two seconds.
+static bool dispatch_until_stores(uint64_t count) {
+	for (int waited = 0; waited < 2000 && caulk_MockStores() < count; waited++) {
+		sleep_ms(1);
+		caulk_Dispatch();
+	}
+	return caulk_MockStores() >= count;
+}
+
+static bool check_stats_store() {
+	caulk_Stat kills = caulk_RegisterStat("kills", caulk_StatInt32);
+	CHECK(kills && caulk_SetStatInt32(kills, 5));
+
+	// a store Steam fails goes out again, once the backoff (capped at the 50 ms interval) is up
+	caulk_MockSetStoreResult(k_EResultFail);
+	caulk_StoreStats();
+	caulk_Dispatch();
+	CHECK(caulk_MockStores() == 1);
+	caulk_MockSetStoreResult(k_EResultOK);
+	caulk_Dispatch();
+	CHECK(caulk_MockStores() == 1);
+	CHECK(dispatch_until_stores(2));
+	caulk_Dispatch();
+	caulk_StoreStats();
+	caulk_Dispatch();
+	CHECK(caulk_MockStores() == 2); // nothing left to store
+
+	// Steam never confirming this one: it's not sent again at the next interval, but is once the store times out
+	// (after 200 ms, in the mocked builds)
+	caulk_MockSetStoreResult(0);
+	CHECK(caulk_SetStatInt32(kills, 6));
+	caulk_StoreStats();
+	caulk_Dispatch();
+	CHECK(caulk_MockStores() == 3);
+	sleep_ms(60);
+	caulk_Dispatch();
+	CHECK(caulk_MockStores() == 3);
+	caulk_MockSetStoreResult(k_EResultOK);
+	CHECK(dispatch_until_stores(4));
+	caulk_Dispatch();
+
+	int32_t stored = 0;
+	CHECK(caulk_SteamUserStats_GetStatInt32("kills", &stored) && stored == 6 && caulk_GetStatInt32(kills) == 6);
+	caulk_StoreStats();
+	caulk_Dispatch();
+	CHECK(caulk_MockStores() == 4);
+	return true;
+}
+
+#define POLL_CONTROLLERS (3)
+#define POLL_DIGITAL (4)
+#define POLL_ANALOG (2)
+
+static bool check_poll_all() {
+	static const InputHandle_t controllers[POLL_CONTROLLERS] = {1, 2, 7};
+	static const InputDigitalActionHandle_t digital[POLL_DIGITAL] = {1, 2, 3, 4};
+	static const InputAnalogActionHandle_t analog[POLL_ANALOG] = {5, 6};
+	bool state[POLL_CONTROLLERS * POLL_DIGITAL], active[POLL_CONTROLLERS * POLL_DIGITAL];
+	float x[POLL_CONTROLLERS * POLL_ANALOG], y[POLL_CONTROLLERS * POLL_ANALOG];
+	bool analog_active[POLL_CONTROLLERS * POLL_ANALOG];
+	memset(active, 0, sizeof(active)), memset(analog_active, 0, sizeof(analog_active));
+	for (size_t i = 0; i < LENGTH(y); i++)
+		y[i] = -1;
+
+	// every field but `y`, controller by controller, the same as the wrappers read them
+	const caulk_DigitalActionStates out_digital = {state, active};
+	const caulk_AnalogActionStates out_analog = {x, NULL, NULL, analog_active};
+	CHECK(caulk_SteamInput_PollAll(
+		controllers, POLL_CONTROLLERS, digital, POLL_DIGITAL, analog, POLL_ANALOG, &out_digital, &out_analog));
+	for (size_t c = 0; c < POLL_CONTROLLERS; c++) {
+		for (size_t a = 0; a < POLL_DIGITAL; a++) {
+			InputDigitalActionData_t data
+				= caulk_SteamInput_GetDigitalActionData(controllers[c], digital[a]);
+			size_t idx = c * POLL_DIGITAL + a;
+			CHECK(state[idx] == data.bState && active[idx] == data.bActive);
+		}
+		for (size_t a = 0; a < POLL_ANALOG; a++) {
+			InputAnalogActionData_t data = caulk_SteamInput_GetAnalogActionData(controllers[c], analog[a]);
+			size_t idx = c * POLL_ANALOG + a;
+			CHECK(x[idx] == data.x && analog_active[idx] == data.bActive && y[idx] == -1);
+		}
+	}
+
+	// no struct, no actions of that kind
+	memset(active, 0, sizeof(active));
+	CHECK(caulk_SteamInput_PollAll(
+		controllers, POLL_CONTROLLERS, digital, POLL_DIGITAL, analog, POLL_ANALOG, NULL, &out_analog));
+	for (size_t i = 0; i < LENGTH(active); i++)
+		CHECK(!active[i]);
+	return true;
+}
+
+static bool fail_allocs = false;
+
+static void* failing_alloc(size_t size, void* userdata) {
+	(void)userdata;
+	return fail_allocs ? NULL : malloc(size);
+}
+
+static void failing_dealloc(void* ptr, void* userdata) {
+	(void)userdata;
+	free(ptr);
+}
+
+static const caulk_Config failing_config = {64, 64, failing_alloc, failing_dealloc, NULL, false, 0, 0, 0, 0, 0, 0};
+
+#define TEST_LOBBY (109775240917893120ull)
+
+static void post_lobby_update(uint64_t lobby) {
+	LobbyDataUpdate_t update = {0};
+	update.m_ulSteamIDLobby = update.m_ulSteamIDMember = lobby;
+	update.m_bSuccess = 1;
+	caulk_MockPost(LobbyDataUpdate_t_iCallback, &update, sizeof(update));
+}
+
+static void post_lobby_chat_update(uint64_t lobby) {
+	LobbyChatUpdate_t update = {0};
+	update.m_ulSteamIDLobby = lobby;
+	caulk_MockPost(LobbyChatUpdate_t_iCallback, &update, sizeof(update));
+}
+
+static bool check_lobby_cache() {
+	caulk_MockSetLobbyKeys(2);
+	CHECK(caulk_CacheLobby(TEST_LOBBY) && caulk_CacheLobby(TEST_LOBBY + 1));
+	const caulk_LobbyCache* cache = caulk_GetLobbyCache();
+	CHECK(cache->count == 2 && !cache->lobbies[0].num_pairs); // read on the next dispatch
+	caulk_Dispatch();
+	CHECK(cache->lobbies[0].num_pairs == 2 && cache->lobbies[1].num_pairs == 2);
+	CHECK(!strcmp(caulk_GetCachedLobbyData(TEST_LOBBY, "key1"), "109775240917893120"));
+	CHECK(!*caulk_GetCachedLobbyData(TEST_LOBBY, "key2") && !caulk_GetCachedLobbyData(TEST_LOBBY + 2, "key1"));
+
+	// only a lobby Steam says changed gets read again, whichever way it says so
+	caulk_MockSetLobbyKeys(3);
+	caulk_Dispatch();
+	CHECK(cache->lobbies[0].num_pairs == 2 && cache->lobbies[1].num_pairs == 2);
+	post_lobby_update(TEST_LOBBY);
+	post_lobby_update(TEST_LOBBY + 2);
+	caulk_Dispatch();
+	CHECK(cache->lobbies[0].num_pairs == 3 && cache->lobbies[1].num_pairs == 2 && cache->count == 2);
+	post_lobby_chat_update(TEST_LOBBY + 1);
+	caulk_Dispatch();
+	CHECK(cache->lobbies[1].num_pairs == 3 && *caulk_GetCachedLobbyData(TEST_LOBBY + 1, "key2"));
+
+	// untracking a lobby moves the last one into its place, still waiting to be read
+	caulk_MockSetLobbyKeys(4);
+	CHECK(caulk_CacheLobby(TEST_LOBBY + 2));
+	CHECK(caulk_UncacheLobby(TEST_LOBBY) && !caulk_UncacheLobby(TEST_LOBBY));
+	caulk_Dispatch();
+	cache = caulk_GetLobbyCache();
+	CHECK(cache->count == 2 && cache->lobbies[0].id == TEST_LOBBY + 2 && cache->lobbies[0].num_pairs == 4);
+	CHECK(cache->lobbies[1].num_pairs == 3);
+	CHECK(!caulk_GetCachedLobbyData(TEST_LOBBY, "key1") && *caulk_GetCachedLobbyData(TEST_LOBBY + 2, "key3"));
+
+	// and a new member key has every lobby read again
+	CHECK(caulk_CacheLobbyMemberKey("ready"));
+	caulk_Dispatch();
+	CHECK(cache->lobbies[1].num_pairs == 4);
+	return true;
+}
+
+static bool check_lobby_retry() {
+	caulk_MockSetLobbyKeys(2);
+	CHECK(caulk_CacheLobby(TEST_LOBBY));
+	caulk_Dispatch();
+	CHECK(caulk_GetLobbyCache()->lobbies[0].num_pairs == 2);
+
+	// more keys than there's room for, and no memory to make more: the old ones stay until the next dispatch
+	caulk_MockSetLobbyKeys(200);
+	post_lobby_update(TEST_LOBBY);
+	fail_allocs = true;
+	caulk_Dispatch();
+	fail_allocs = false;
+	CHECK(caulk_GetLobbyCache()->lobbies[0].num_pairs == 2);
+	CHECK(*caulk_GetCachedLobbyData(TEST_LOBBY, "key1"));
+
+	caulk_Dispatch();
+	CHECK(caulk_GetLobbyCache()->lobbies[0].num_pairs == 200);
+	CHECK(*caulk_GetCachedLobbyData(TEST_LOBBY, "key199"));
+	return true;
+}
+
+#ifdef CAULK_STATS
+#define TEST_UNHANDLED (100002)
+
+static const caulk_CallbackStats* find_stats(uint32_t callback) {
+	const caulk_DispatchStats* stats = caulk_GetDispatchStats();
+	for (size_t i = 0; i < stats->num_callbacks; i++)
+		if (stats->callbacks[i].callback == callback)
+			return &stats->callbacks[i];
+	return NULL;
+}
+
+static bool check_dispatch_stats() {
+	int handled = 0;
+	caulk_RegisterCtx(TEST_CALLBACK, on_counted, &handled);
+	for (uint64_t i = 0; i < 3; i++)
+		post(i);
+	Message message = {0, {0, 0}};
+	caulk_MockPost(TEST_UNHANDLED, &message, sizeof(message));
+
+	// the second registration for the same call is refused
+	Resolved resolved = {0};
+	CHECK(caulk_ResolveCtx(0xC0FFEE, on_resolved, &resolved));
+	CHECK(!caulk_ResolveCtx(0xC0FFEE, on_resolved, &resolved));
+	caulk_Dispatch();
+	CHECK(handled == 3);
+
+	const caulk_DispatchStats* stats = caulk_GetDispatchStats();
+	CHECK(stats && stats->pending_results == 1 && stats->dropped_registrations == 1);
+
+	const caulk_CallbackStats* counted = find_stats(TEST_CALLBACK);
+	CHECK(counted && counted->messages == 3 && counted->bytes == 3 * sizeof(Message) && !counted->unhandled);
+	uint32_t timed = 0;
+	for (size_t i = 0; i < CAULK_STATS_BUCKETS; i++)
+		timed += counted->histogram[i];
+	CHECK(timed == 3);
+
+	const caulk_CallbackStats* unhandled = find_stats(TEST_UNHANDLED);
+	CHECK(unhandled && unhandled->messages == 1 && unhandled->unhandled == 1 && !unhandled->handler_ns);
+
+	// the counters go back to zero, what's still registered doesn't
+	caulk_ResetDispatchStats();
+	stats = caulk_GetDispatchStats();
+	CHECK(!stats->num_callbacks && !stats->dropped_registrations && !stats->run_frame_ns);
+	CHECK(stats->pending_results == 1 && caulk_Cancel(0xC0FFEE));
+
+	post(3);
+	caulk_Dispatch();
+	counted = find_stats(TEST_CALLBACK);
+	CHECK(stats->num_callbacks == 1 && counted && counted->messages == 1);
+	return true;
+}
+#endif
+
+typedef struct {
+	const char* name;
+	bool (*run)();
+	const caulk_Config* config; // `NULL` for the defaults
+} Check;
+
+static const Check checks[] = {
+	{"unregister_during_dispatch", check_unregister_during_dispatch, NULL            },
+	{"stale_handle",               check_stale_handle,               NULL            },
+	{"budget_hold",                check_budget_hold,                NULL            },
+	{"dispatch_into",              check_dispatch_into,              NULL            },
+	{"coalesce",                   check_coalesce,                   NULL            },
+	{"friends_snapshot",           check_friends_snapshot,           &friends_config },
+	{"timeout",                    check_timeout,                    NULL            },
+	{"poll_eviction",              check_poll_eviction,              &poll_config    },
+	{"poll_all",                   check_poll_all,                   NULL            },
+	{"queue_oversized",            check_queue_oversized,            &threaded_config},
+	{"stats_store",                check_stats_store,                &stats_config   },
+	{"lobby_cache",                check_lobby_cache,                NULL            },
+	{"lobby_retry",                check_lobby_retry,                &failing_config },
+#ifdef CAULK_STATS
+	{"dispatch_stats",             check_dispatch_stats,             NULL            },
+#endif
+};
+
 int main(int argc, char* argv[]) {
 	(void)argc, (void)argv;
 
@@ -43,8 +688,25 @@ int main(int argc, char* argv[]) {
 	printf("CAULK TEST\n");
 	printf("==========\n\n");
 
+	bool ok = true;
+	for (size_t i = 0; i < LENGTH(checks); i++) {
+		caulk_MockReset();
+		if (!caulk_InitEx(checks[i].config)) {
+			printf("ERROR: caulk_InitEx() failed against the mock.\n");
+			return EXIT_FAILURE;
+		}
+
+		bool passed = checks[i].run();
+		printf("%s: %s\n", checks[i].name, passed ? "ok" : "FAILED");
+		ok &= passed;
+		caulk_Shutdown();
+	}
+	printf("\n");
+
+	caulk_MockReset();
+	caulk_MockSetFriends(3);
 	if (!caulk_Init()) {
-		printf("ERROR: No caulk here, try opening Steam.\n");
+		printf("ERROR: caulk_Init() failed against the mock.\n");
 		return EXIT_FAILURE;
 	}
 
@@ -60,9 +722,6 @@ int main(int argc, char* argv[]) {
 		printf("%d. %s (%" PRI_SteamID ")\n", i + 1, friend_name, friend);
 	}
 
-	fflush(stdout);
-	sleep_secs(5);
-
 	caulk_Shutdown();
-	return EXIT_SUCCESS;
+	return ok ? EXIT_SUCCESS : EXIT_FAILURE;
 }